@@ -0,0 +1,678 @@
+// Simulation worker: owns the module and everything that runs it.
+//
+// The page (index.html) keeps only input and controls. It starts this
+// worker with { type: 'start', search, canvas, ring, speed, hidden } and
+// then talks to it in messages: pointer input comes through the shared ring
+// (see Input below), each control posts a message (see onmessage at the
+// end), and the worker reports what the controls show with post().
+//
+// Stepping, rendering, autosave, recording and replay all happen here, so
+// layout, style and garbage collection on the page's thread no longer
+// hold up the simulation, and a long step no longer holds up the page.
+// canvas is the page's canvas, handed over with transferControlToOffscreen():
+// the dirty rectangles render() reports are drawn straight into it and the
+// browser shows them with the worker's animation frame. A browser that
+// cannot hand over a canvas gets none; the worker then draws whole frames
+// into an OffscreenCanvas of its own and posts each as an ImageBitmap
+// (transferToImageBitmap()), which the page shows with a bitmaprenderer
+// context.
+
+// Imports for WASM
+const imports = {
+    env: {
+        console_log: (val) => console.log(val),
+        get_time_ms: () => Date.now(),
+        sin: Math.sin,
+        cos: Math.cos,
+        fabs: Math.abs,
+        _Znwm: (size) => 0, // Allocator stub
+        __cxa_atexit: () => 0
+    }
+};
+
+let wasmExports = null;
+let memory = null;
+let params = null;
+// Screen size in pixels, set from the module after init()
+let width = 320;
+let height = 200;
+let hidden = false; // the page is not visible
+
+const post = (message, transfer) => self.postMessage(message, transfer || []);
+
+// WebAssembly SIMD detection: validate a minimal module whose only
+// function uses v128 instructions (i8x16.splat + i8x16.popcnt).
+const simdSupported = WebAssembly.validate(new Uint8Array([
+    0, 97, 115, 109, 1, 0, 0, 0, 1, 5, 1, 96, 0, 1, 123, 3, 2, 1, 0,
+    10, 10, 1, 8, 0, 65, 0, 253, 15, 253, 98, 11
+]));
+
+// Exports the worker calls without checking for them first. The .wasm
+// files are build outputs (`make`), and one built from older sources
+// lacks some; it is then passed over for the next build in line, as if
+// it had failed to load. set_sim_mode, set_param and the history exports
+// are optional.
+const REQUIRED_EXPORTS = [
+    'init', 'get_screen_width', 'get_screen_height', 'get_input_queue',
+    'get_input_queue_size', 'get_max_pointers', 'set_speed', 'get_speed',
+    'seed_random', 'get_random_seed', 'advance', 'fast_forward', 'is_idle',
+    'render', 'get_dirty_rect_count', 'get_dirty_rects', 'get_video_buffer',
+    'get_snapshot_buffer', 'get_snapshot_capacity', 'load_snapshot',
+    'save_snapshot', 'save_game_state', 'get_tile_count', 'save_tile',
+    'save_checkpoint', 'start_recording', 'stop_recording', 'take_recording',
+    'get_recording_buffer', 'replay_buffer', 'open_replay', 'replay_to',
+    'seek_replay', 'replay_done', 'get_replay_length',
+    'get_replay_checkpoints', 'get_replay_mismatches', 'close_replay'
+];
+
+function checkExports(url, exports, extra) {
+    const missing = REQUIRED_EXPORTS.concat(extra)
+        .filter(name => typeof exports[name] !== 'function');
+    if (missing.length)
+        throw new Error(url + ' is out of date (no ' + missing.join(', ') + '), rebuild it with make');
+}
+
+function loadModule(url) {
+    return fetch(url)
+        .then(response => {
+            if (!response.ok) throw new Error(url + ': ' + response.status);
+            return response.arrayBuffer();
+        })
+        .then(bytes => WebAssembly.instantiate(bytes, imports))
+        .then(results => {
+            checkExports(url, results.instance.exports, []);
+            if (!(results.instance.exports.memory instanceof WebAssembly.Memory))
+                throw new Error(url + ' exports no memory');
+            return results;
+        });
+}
+
+// Log why a build was passed over and load the next one
+const fallBack = (next) => (error) => {
+    console.warn(error.message || error);
+    return next();
+};
+
+// Prefer the SIMD build; fall back to the scalar one if the browser
+// lacks SIMD or the SIMD module cannot be loaded.
+const loadSimd = () => loadModule('slime-simd.wasm').then(results => ({ results, simd: true }));
+const loadScalar = () => loadModule('slime.wasm').then(results => ({ results, simd: false }));
+const loadSingle = () => simdSupported ? loadSimd().catch(fallBack(loadScalar)) : loadScalar();
+
+
+// Threaded build: ?threads=N picks the thread count (1 disables it).
+// Needs SharedArrayBuffer, i.e. a cross-origin isolated page (served
+// with COOP/COEP headers, see `make serve`). The band workers
+// (worker.js) are started from this worker, which is thread 0.
+function loadThreads(threadCount) {
+    // Pages of 64 KiB: 16 MiB to start, up to --max-memory (256 MiB, Makefile)
+    const memory = new WebAssembly.Memory({ initial: 256, maximum: 4096, shared: true });
+    const threadImports = { env: { ...imports.env, memory } };
+    return fetch('slime-threads.wasm')
+        .then(response => {
+            if (!response.ok) throw new Error('slime-threads.wasm: ' + response.status);
+            return response.arrayBuffer();
+        })
+        .then(bytes => WebAssembly.compile(bytes))
+        .then(module => WebAssembly.instantiate(module, threadImports).then(instance => {
+            checkExports('slime-threads.wasm', instance.exports,
+                ['set_thread_count', 'worker_main', 'worker_stack_top']);
+            const workers = [];
+            for (let id = 1; id < threadCount; id++) {
+                workers.push(new Promise((resolve, reject) => {
+                    const worker = new Worker('worker.js');
+                    worker.onmessage = (e) => e.data === 'ready' ? resolve() : reject(new Error(e.data));
+                    worker.onerror = reject;
+                    worker.postMessage({ module, memory, id });
+                }));
+            }
+            return Promise.all(workers).then(() => ({
+                results: { instance }, simd: true, memory, threads: threadCount
+            }));
+        }));
+}
+
+function start(search, canvas, ring, selected) {
+    params = new URLSearchParams(search);
+    // Field size: ?size=WxH (e.g. ?size=1920x1080). The sidebar is added
+    // to the right, so the canvas is 20 pixels wider than the field.
+    const [fieldWidth, fieldHeight] = (params.get('size') || '')
+        .split('x').map(v => parseInt(v, 10) || 0);
+    const threadCount = Math.max(1, Math.min(16,
+        parseInt(params.get('threads'), 10) ||
+        Math.min(navigator.hardwareConcurrency || 1, 4)));
+    const threadsSupported = simdSupported && threadCount > 1 &&
+        self.crossOriginIsolated === true;
+
+    (threadsSupported ? loadThreads(threadCount).catch(fallBack(loadSingle)) : loadSingle())
+        .then(({ results, simd, memory: sharedMemory, threads }) => {
+            wasmExports = results.instance.exports;
+            memory = sharedMemory || wasmExports.memory;
+            if (!wasmExports.init(fieldWidth || 0, fieldHeight || 0))
+                console.warn('Field size too large, using the default');
+            width = wasmExports.get_screen_width();
+            height = wasmExports.get_screen_height();
+            startPresenting(canvas);
+            frame = new Uint8ClampedArray(width * height * 4);
+            inputQueue = wasmExports.get_input_queue();
+            inputSize = wasmExports.get_input_queue_size();
+            maxPointers = wasmExports.get_max_pointers();
+            pointerRing = ring;
+            if (threads) wasmExports.set_thread_count(threads);
+            speed = selected;
+            wasmExports.set_speed(speed);
+            // ?seed=N replays a run exactly, so it starts from an empty
+            // field rather than the saved scene; otherwise pick a fresh
+            // seed (a restored scene brings its own generator state)
+            const seed = params.has('seed') ? parseInt(params.get('seed'), 10) >>> 0
+                : crypto.getRandomValues(new Uint32Array(1))[0];
+            wasmExports.seed_random(seed);
+            console.log(threads ? 'Loaded threaded module (' + threads + ' threads)'
+                : simd ? 'Loaded SIMD module' : 'Loaded scalar module');
+            return startAutosave(params.has('fresh') || params.has('seed')).then(() => {
+                // The vector kernel implements the Jacobi update scheme
+                if (simd && wasmExports.set_sim_mode) wasmExports.set_sim_mode(1);
+                // ?sweep=alternating|serpentine: sweep order of the in-place
+                // (scalar) kernel, Param::SweepOrder
+                const sweepOrders = { reference: 0, alternating: 1, serpentine: 2 };
+                if (params.has('sweep') && wasmExports.set_param)
+                    wasmExports.set_param(4, sweepOrders[params.get('sweep')] || 0);
+                console.log('Random seed ' + (wasmExports.get_random_seed() >>> 0));
+                // A restored scene brings the speed it was saved at
+                speed = wasmExports.get_speed();
+                post({ type: 'ready', width, height, maxPointers, speed });
+                wake();
+            });
+        })
+        .catch(error => {
+            console.error(error);
+            post({ type: 'error', message: String(error.message || error) });
+        });
+}
+
+// Presentation
+
+let view = null;         // canvas drawn into
+let viewContext = null;
+let placeholder = false; // view is the page's canvas
+// ImageData cannot wrap shared memory, so the threaded build copies
+// the dirty rectangles into this buffer first
+let frame = null;
+
+function startPresenting(canvas) {
+    placeholder = !!canvas;
+    view = canvas || new OffscreenCanvas(width, height);
+    view.width = width;
+    view.height = height;
+    viewContext = view.getContext('2d');
+}
+
+// Render and draw what changed; a posted frame has to be whole, as
+// transferToImageBitmap() leaves the canvas blank
+function present() {
+    wasmExports.render();
+    const count = wasmExports.get_dirty_rect_count();
+    if (count === 0) return;
+    const rects = placeholder
+        ? new Int32Array(memory.buffer, wasmExports.get_dirty_rects(), count * 4)
+        : [0, 0, width, height];
+    let buffer = new Uint8ClampedArray(memory.buffer, wasmExports.get_video_buffer(), width * height * 4);
+    if (!(memory.buffer instanceof ArrayBuffer)) {
+        for (let i = 0; i < rects.length; i += 4) {
+            const [x, y, w, h] = rects.slice(i, i + 4);
+            for (let row = y; row < y + h; row++) {
+                const start = (row * width + x) * 4;
+                frame.set(buffer.subarray(start, start + w * 4), start);
+            }
+        }
+        buffer = frame;
+    }
+    const imageData = new ImageData(buffer, width, height);
+    for (let i = 0; i < rects.length; i += 4)
+        viewContext.putImageData(imageData, 0, 0, rects[i], rects[i + 1], rects[i + 2], rects[i + 3]);
+    if (!placeholder) {
+        const bitmap = view.transferToImageBitmap();
+        post({ type: 'frame', bitmap }, [bitmap]);
+    }
+}
+
+// Game loop
+//
+// The simulation runs at a fixed 60 steps per second of (speed-scaled)
+// time: advance() works out how many steps the elapsed time covers and
+// runs them in one call, so flow speed does not depend on the display
+// refresh rate and the speed multiplier costs no extra rendering.
+let lastTime = null;
+
+// Once the water has come to rest (is_idle()) the loop stops
+// stepping and presenting altogether and wake() restarts it when
+// input arrives. A hidden page is not presented: it wakes on a slow
+// timer and owes the steps its time covers as catch-up.
+//
+// Catch-up steps (time spent hidden, or the Skip button) are run by
+// fast_forward() without input or rendering, at most
+// CATCH_UP_BUDGET_MS of them per frame so the page stays responsive,
+// or HIDDEN_BUDGET_MS per hidden tick.
+const HIDDEN_TICK_MS = 1000;
+const STEP_MS = 1000 / 60;        // STEP_MS in platform.h
+const CATCH_UP_BUDGET_MS = 8;
+const HIDDEN_BUDGET_MS = 100;
+const MAX_CATCH_UP = 60 * 60 * 10; // ten minutes at 1x; more is dropped
+let frameRequest = null; // pending animation frame
+let timer = null;        // pending hidden-page tick
+let catchUp = 0;         // steps owed
+
+// Workers have animation frames only where they can draw into a canvas
+const requestFrame = self.requestAnimationFrame
+    ? (fn) => requestAnimationFrame(fn)
+    : (fn) => setTimeout(() => fn(performance.now()), STEP_MS);
+const cancelFrame = self.cancelAnimationFrame
+    ? (id) => cancelAnimationFrame(id)
+    : (id) => clearTimeout(id);
+
+// Make sure the loop runs, in the form the page's visibility calls for
+function wake() {
+    if (!wasmExports) return;
+    if (hidden ? timer !== null : frameRequest !== null) return;
+    cancelFrame(frameRequest);
+    clearTimeout(timer);
+    frameRequest = timer = null;
+    if (hidden) timer = setTimeout(hiddenTick, HIDDEN_TICK_MS);
+    else frameRequest = requestFrame(loop);
+}
+
+// Run the steps due at time and a slice of the catch-up; false once
+// idle, so the loop can stop
+function step(time, budgetMs) {
+    drainPointers();
+    if (replaying) return replayStep(time);
+    if (scrubbing) return false;
+    let steps = wasmExports.advance(lastTime === null ? 0 : time - lastTime);
+    lastTime = time;
+    if (recording) takeInput();
+    catchUp = Math.min(catchUp, MAX_CATCH_UP);
+    if (catchUp >= 1) {
+        const done = wasmExports.fast_forward(Math.floor(catchUp), budgetMs);
+        catchUp -= done;
+        steps += done;
+    }
+    if (steps > 0) pushHistory();
+    if (catchUp >= 1 || !wasmExports.is_idle()) return true;
+    lastTime = null; // resting time is not made up on waking
+    return false;
+}
+
+function hiddenTick() {
+    timer = null;
+    const now = performance.now();
+    if (lastTime !== null)
+        catchUp += (now - lastTime) * wasmExports.get_speed() / STEP_MS;
+    lastTime = now;
+    if (step(now, HIDDEN_BUDGET_MS)) timer = setTimeout(hiddenTick, HIDDEN_TICK_MS);
+}
+
+function loop(time) {
+    frameRequest = null;
+    const busy = step(time, CATCH_UP_BUDGET_MS);
+    present();
+    if (busy) frameRequest = requestFrame(loop);
+}
+
+// Autosave
+//
+// The scene survives a reload. It is kept in IndexedDB as snapshot
+// records (src/snapshot.h) under keys prefixed with the screen size:
+// one full record ('base'), the game state ('state') and one record
+// per tile ('tile<i>'). Only the base is written whole, when there is
+// none yet; from then on a pass every AUTOSAVE_MS writes the state
+// and the tiles that changed since they were last saved, encoding
+// them AUTOSAVE_SLICE_MS at a time in idle callbacks so that saving
+// never holds up a frame. Tiles saved a moment apart can come from
+// different steps, which a restore cannot tell apart. Hiding the page
+// finishes the pass at once. ?fresh starts from an empty field and
+// replaces the saved scene.
+const AUTOSAVE_MS = 2000;
+const AUTOSAVE_SLICE_MS = 4;
+let db = null;
+let savePrefix = '';
+let saveCursor = -1;  // next tile of the pass under way, -1 if none
+let saveQueue = [];   // [key, record] pairs not yet written
+let savedState = null; // last state record written
+
+const idb = (request) => new Promise((resolve, reject) => {
+    request.onsuccess = () => resolve(request.result);
+    request.onerror = () => reject(request.error);
+});
+
+const whenIdle = self.requestIdleCallback
+    ? (fn) => requestIdleCallback(fn, { timeout: 500 })
+    : (fn) => setTimeout(fn, 0);
+
+// Copy the first size bytes of the snapshot buffer out of memory
+function takeRecord(size) {
+    return new Uint8Array(memory.buffer, wasmExports.get_snapshot_buffer(), size).slice();
+}
+
+function loadRecord(record) {
+    if (record.length > wasmExports.get_snapshot_capacity()) return false;
+    new Uint8Array(memory.buffer, wasmExports.get_snapshot_buffer(), record.length).set(record);
+    return wasmExports.load_snapshot(record.length) === 1;
+}
+
+function savedRange() {
+    return IDBKeyRange.bound(savePrefix, savePrefix + '\uffff');
+}
+
+// Replace the saved scene with the current one
+function saveBase() {
+    const store = db.transaction('autosave', 'readwrite').objectStore('autosave');
+    store.delete(savedRange());
+    store.put(takeRecord(wasmExports.save_snapshot()), savePrefix + 'base');
+}
+
+// Open the database and restore the saved scene, or save this one
+function startAutosave(fresh) {
+    if (!self.indexedDB) return Promise.resolve();
+    savePrefix = width + 'x' + height + '/';
+    const open = indexedDB.open('slime', 1);
+    open.onupgradeneeded = () => open.result.createObjectStore('autosave');
+    return idb(open).then(database => {
+        db = database;
+        const store = db.transaction('autosave').objectStore('autosave');
+        return Promise.all([idb(store.getAllKeys(savedRange())), idb(store.getAll(savedRange()))]);
+    }).then(([keys, records]) => {
+        const base = keys.indexOf(savePrefix + 'base');
+        if (fresh || base < 0 || !loadRecord(records[base])) {
+            saveBase();
+        } else {
+            keys.forEach((key, i) => {
+                if (i !== base && !loadRecord(records[i]))
+                    console.warn('Autosave: skipped ' + key);
+            });
+            console.log('Restored the saved scene (' + keys.length + ' records)');
+        }
+        setInterval(autosave, AUTOSAVE_MS);
+    }).catch(e => console.warn('Autosave unavailable', e));
+}
+
+// Start a pass: save the state now and the tiles in idle time
+function autosave() {
+    if (saveCursor >= 0) return;
+    saveCursor = 0;
+    // An idle world's state stays the same; skip rewriting it
+    const state = takeRecord(wasmExports.save_game_state());
+    if (!savedState || state.some((b, i) => b !== savedState[i])) {
+        saveQueue.push(['state', state]);
+        savedState = state;
+    }
+    whenIdle(() => saveTiles(AUTOSAVE_SLICE_MS));
+}
+
+// Encode the pass's next tiles for up to sliceMs and write them
+function saveTiles(sliceMs) {
+    if (saveCursor < 0) return;
+    const count = wasmExports.get_tile_count();
+    const start = performance.now();
+    while (saveCursor < count && performance.now() - start < sliceMs) {
+        const size = wasmExports.save_tile(saveCursor);
+        if (size) saveQueue.push(['tile' + saveCursor, takeRecord(size)]);
+        saveCursor++;
+    }
+    if (saveQueue.length) {
+        const store = db.transaction('autosave', 'readwrite').objectStore('autosave');
+        for (const [key, record] of saveQueue) store.put(record, savePrefix + key);
+        saveQueue = [];
+    }
+    if (saveCursor < count) whenIdle(() => saveTiles(AUTOSAVE_SLICE_MS));
+    else saveCursor = -1;
+}
+
+// Recording and replay
+//
+// Record logs the input of the session (src/replay.h) from a
+// checkpoint of the current scene on, with a further checkpoint every
+// CHECKPOINT_MS, and Stop hands it to the page to download as a .slrec
+// file: a log is the magic "SLR1" and chunks of u8 type, u32 size and
+// the payload, the checkpoints ('C') as save_checkpoint() writes them
+// and the input ('I') as take_recording() hands it over, once per
+// frame. Replay plays such a file back at the selected speed, ignoring
+// the pointer, and returns to the live game at its end.
+// tools/replay.cpp replays the same files headless.
+const CHECKPOINT_MS = 10000;
+let recording = null;  // chunks of the session being recorded
+let checkpointTimer = null;
+let replaying = false;
+let replayAt = 0;      // step counter the replay has reached
+let replayDebt = 0;    // steps due but not yet replayed
+let speed = 1;         // speed selected on the page
+
+function chunk(type, payload) {
+    const header = new Uint8Array(5);
+    header[0] = type.charCodeAt(0);
+    new DataView(header.buffer).setUint32(1, payload.length, true);
+    recording.push(header, payload);
+}
+
+// Append the input logged since the last call
+function takeInput() {
+    const size = wasmExports.take_recording();
+    if (size > 0)
+        chunk('I', new Uint8Array(memory.buffer, wasmExports.get_recording_buffer(), size).slice());
+    if (size < 0) {
+        console.warn('Recording lost: input log overflowed');
+        stopRecording(false);
+    }
+}
+
+function checkpoint() {
+    const record = takeRecord(wasmExports.save_checkpoint());
+    takeInput();
+    if (recording) chunk('C', record);
+}
+
+function startRecording() {
+    if (!wasmExports || replaying || !wasmExports.start_recording()) return;
+    recording = [new TextEncoder().encode('SLR1')];
+    checkpoint();
+    checkpointTimer = setInterval(checkpoint, CHECKPOINT_MS);
+    post({ type: 'recording', active: true });
+}
+
+function stopRecording(download) {
+    clearInterval(checkpointTimer);
+    wasmExports.stop_recording();
+    if (download) takeInput();
+    if (download && recording) {
+        post({
+            type: 'download', blob: new Blob(recording),
+            name: 'slime-' + (wasmExports.get_random_seed() >>> 0) + '.slrec'
+        });
+    }
+    recording = null;
+    post({ type: 'recording', active: false });
+}
+
+function openReplay(name, log) {
+    if (recording) stopRecording(true);
+    const target = wasmExports.replay_buffer(log.length);
+    if (!target) return console.warn('Replay: out of memory');
+    new Uint8Array(memory.buffer, target, log.length).set(log);
+    if (!wasmExports.open_replay(log.length)) {
+        // The first checkpoint's header holds the field size
+        const view = new DataView(log.buffer, log.byteOffset, log.length);
+        const size = log.length >= 18
+            ? view.getUint16(14, true) + 'x' + view.getUint16(16, true) : '?';
+        return console.warn('Replay: not a session log, or one recorded with ?size=' + size);
+    }
+    replaying = true;
+    post({ type: 'replaying', active: true });
+    replayAt = wasmExports.replay_to(0);
+    replayDebt = 0;
+    catchUp = 0;
+    speed = wasmExports.get_speed();
+    post({ type: 'speed', value: speed });
+    console.log('Replaying ' + name + ' (' + wasmExports.get_replay_length() + ' steps)');
+    wake();
+}
+
+// Replay the steps the time since the last frame covers
+function replayStep(time) {
+    replayDebt += (lastTime === null ? 0 : time - lastTime) * wasmExports.get_speed() / STEP_MS;
+    lastTime = time;
+    const steps = Math.floor(replayDebt);
+    replayDebt -= steps;
+    replayAt = wasmExports.replay_to(replayAt + steps);
+    if (wasmExports.replay_done()) {
+        replaying = false;
+        post({ type: 'replaying', active: false });
+        const mismatched = wasmExports.get_replay_mismatches();
+        console.log('Replay finished, ' + wasmExports.get_replay_checkpoints() +
+            ' checkpoints' + (mismatched ? ', ' + mismatched + ' did not match' : ''));
+        wasmExports.close_replay();
+    }
+    return true;
+}
+
+function skip() {
+    // A replay jumps ahead in its log instead
+    if (replaying) {
+        // Loading a checkpoint brings its speed; keep the selected one
+        replayAt = wasmExports.seek_replay(replayAt + 60 * 1000 / STEP_MS);
+        wasmExports.set_speed(speed);
+    } else catchUp += 60 * 1000 / STEP_MS;
+    wake();
+}
+
+// Rewind history
+//
+// Every frame that ran steps is pushed to the module's history
+// (src/history.h), which keeps as many recent frames as its memory
+// holds. While the page's History slider is dragged the field is
+// rewound to the frame under it and the simulation is held; the game
+// then goes on from that frame and the frames after it are dropped. Not
+// while recording or replaying, as a rewind is not part of the input log.
+let scrubbing = false;
+let historyLength = 0; // last length posted to the page
+
+function pushHistory() {
+    if (!wasmExports.push_history) return;
+    wasmExports.push_history();
+    historyLength = wasmExports.get_history_length();
+    post({ type: 'history', length: historyLength });
+}
+
+function rewind(index) {
+    if (recording || replaying) return;
+    scrubbing = true;
+    wasmExports.rewind_history(index);
+    // A rewound game state brings the speed it had; keep the selected one
+    wasmExports.set_speed(speed);
+    wake();
+}
+
+// Input
+//
+// The page writes pointer samples into a ring in a SharedArrayBuffer
+// (see index.html), laid out like the module's input queue (InputQueue
+// in src/input.h): u32 head, u32 tail, then 24-byte events of
+// { f64 time, i32 x, i32 y, i32 buttons, i32 pointer }. The page only
+// writes events and head, this worker only tail, each with Atomics, so
+// neither side waits for the other. Each frame moves the events into
+// the module's queue before advance(), which drains them in order, so
+// every coalesced sample of a fast stroke still reaches the simulation.
+// An idle worker has no frame to drain them in: the page posts 'wake'
+// when it writes into an empty ring. A page that is not cross-origin
+// isolated has no SharedArrayBuffer and posts each event instead.
+let inputQueue = 0;
+let inputSize = 0;
+let inputView = null;
+let maxPointers = 1;
+let pointerRing = null;
+
+function drainPointers() {
+    if (!pointerRing) return;
+    const header = new Int32Array(pointerRing, 0, 2);
+    const events = new DataView(pointerRing);
+    const size = (pointerRing.byteLength - 8) / 24;
+    const head = Atomics.load(header, 0);
+    for (let tail = Atomics.load(header, 1); tail !== head; tail = (tail + 1) | 0) {
+        const event = 8 + ((tail >>> 0) % size) * 24;
+        pushPointer(events.getInt32(event + 20, true), events.getInt32(event + 8, true),
+            events.getInt32(event + 12, true), events.getInt32(event + 16, true),
+            events.getFloat64(event, true));
+    }
+    Atomics.store(header, 1, head);
+}
+
+// Append one event to the module's input queue
+function pushPointer(slot, x, y, buttons, time) {
+    if (slot < 0 || slot >= maxPointers || replaying) return;
+    // Views detach when memory grows; recreate on demand
+    if (!inputView || inputView.buffer !== memory.buffer)
+        inputView = new DataView(memory.buffer);
+    const head = inputView.getUint32(inputQueue, true);
+    const tail = inputView.getUint32(inputQueue + 4, true);
+    let index = head;
+    if (head - tail >= inputSize) {
+        // Full: fold a move into the newest event, drop anything else
+        const last = inputQueue + 8 + ((head - 1) % inputSize) * 24;
+        if (inputView.getInt32(last + 16, true) !== buttons ||
+            inputView.getInt32(last + 20, true) !== slot) return;
+        index = head - 1;
+    }
+    const event = inputQueue + 8 + (index % inputSize) * 24;
+    inputView.setFloat64(event, time, true);
+    inputView.setInt32(event + 8, x, true);
+    inputView.setInt32(event + 12, y, true);
+    inputView.setInt32(event + 16, buttons, true);
+    inputView.setInt32(event + 20, slot, true);
+    inputView.setUint32(inputQueue, index + 1, true);
+}
+
+self.onmessage = (e) => {
+    const message = e.data;
+    if (message.type === 'start') {
+        hidden = message.hidden;
+        return start(message.search, message.canvas, message.ring, message.speed);
+    }
+    if (message.type === 'visibility') hidden = message.hidden;
+    if (!wasmExports) return;
+    switch (message.type) {
+        case 'wake':
+            wake();
+            break;
+        case 'pointer':
+            pushPointer(...message.event);
+            wake();
+            break;
+        case 'visibility':
+            if (hidden && db) {
+                autosave();
+                saveTiles(Infinity);
+            }
+            wake();
+            break;
+        case 'speed':
+            speed = message.value;
+            wasmExports.set_speed(speed);
+            break;
+        case 'skip':
+            skip();
+            break;
+        case 'record':
+            if (recording) stopRecording(true);
+            else startRecording();
+            break;
+        case 'replay':
+            openReplay(message.name, new Uint8Array(message.log));
+            break;
+        case 'rewind':
+            rewind(message.index);
+            break;
+        case 'scrub-end':
+            scrubbing = false;
+            lastTime = null; // time spent scrubbing is not made up
+            wake();
+            break;
+    }
+};
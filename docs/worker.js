@@ -0,0 +1,27 @@
+// Simulation worker for the threaded build (slime-threads.wasm).
+//
+// The page posts { module, memory, id }. The worker instantiates the module
+// against the shared memory, moves its shadow stack to the slot reserved for
+// it, reports back and then runs the worker loop, which never returns.
+
+self.onmessage = (e) => {
+    const { module, memory, id } = e.data;
+    const imports = {
+        env: {
+            memory,
+            console_log: (val) => console.log(val),
+            get_time_ms: () => Date.now(),
+            sin: Math.sin,
+            cos: Math.cos,
+            fabs: Math.abs,
+            _Znwm: (size) => 0, // Allocator stub
+            __cxa_atexit: () => 0
+        }
+    };
+    WebAssembly.instantiate(module, imports).then(instance => {
+        const exports = instance.exports;
+        exports.__stack_pointer.value = exports.worker_stack_top(id);
+        self.postMessage('ready');
+        exports.worker_main(id);
+    }).catch(err => self.postMessage('error: ' + err));
+};
@@ -0,0 +1,143 @@
+/**
+ * @file arena.cpp
+ * @brief Allocator for the buffers sized by init()
+ *
+ * All runtime-sized buffers (field, video buffer, kernel scratch planes) are
+ * allocated once per init() and released together, so a bump allocator is
+ * enough. In WASM it grows linear memory past __heap_base; native builds use
+ * calloc.
+ *
+ * Each world (see context.cpp) has its own arena. In WASM a world bumps
+ * through its own region of linear memory; if another world has been placed
+ * after it and the region is too small, the world moves to the end of
+ * memory and its old region is given up, since memory cannot shrink.
+ */
+
+#include "platform.h"
+
+static ArenaState arena;
+
+void saveArenaState(ArenaState *state) { *state = arena; }
+
+void loadArenaState(const ArenaState &state) { arena = state; }
+
+#if defined(__wasm__)
+
+/// First free byte after static data and the stack (provided by wasm-ld)
+extern "C" uint8_t __heap_base;
+
+/// End of the memory claimed by all worlds together
+static unsigned long heap_end = 0;
+
+/// Claim n bytes (16-byte aligned) at the end of the heap, growing memory
+static unsigned long claim(unsigned long n) {
+  if (!heap_end)
+    heap_end = (unsigned long)&__heap_base;
+  unsigned long start = (heap_end + 15) & ~15ul;
+  unsigned long end = start + n;
+  if (end < start)
+    return 0;
+  unsigned long size = __builtin_wasm_memory_size(0) * 65536ul;
+  if (end > size &&
+      __builtin_wasm_memory_grow(0, (end - size + 65535) / 65536) < 0)
+    return 0;
+  heap_end = end;
+  return start;
+}
+
+uint8_t *arenaAlloc(unsigned long n) {
+  unsigned long start = (arena.top + 15) & ~15ul;
+  bool fits = arena.end && start + n >= start && start + n <= arena.end;
+  if (!fits && arena.end && arena.end == heap_end) {
+    // Last region in memory: extend it in place
+    if (!claim(start + n - heap_end))
+      return nullptr;
+    arena.end = heap_end;
+  } else if (!fits) {
+    // Start a new region at the end of memory; anything still allocated in
+    // the old one stays valid until the next arenaReset()
+    start = claim(n);
+    if (!start)
+      return nullptr;
+    arena.base = start;
+    arena.end = heap_end;
+  }
+  arena.top = start + n;
+  // Memory handed out before arenaReset() may hold old data
+  memset((void *)start, 0, n);
+  return (uint8_t *)start;
+}
+
+uint8_t *arenaGrow(uint8_t *p, unsigned long size, unsigned long n) {
+  unsigned long start = (unsigned long)p;
+  if (!p || start + size != arena.top || start + n < start)
+    return nullptr;
+  if (start + n > arena.end) {
+    // Only a region at the end of memory can extend in place
+    if (arena.end != heap_end || !claim(start + n - heap_end))
+      return nullptr;
+    arena.end = heap_end;
+  }
+  if (n > size)
+    memset(p + size, 0, n - size);
+  arena.top = start + n;
+  return p;
+}
+
+void arenaReset() {
+  if (arena.end && arena.end == heap_end) {
+    // The last region is handed back to whichever world claims memory next
+    heap_end = arena.base;
+    arena.end = 0;
+  }
+  arena.top = arena.base;
+}
+
+uint8_t *permanentAlloc(unsigned long n) {
+  unsigned long start = claim(n);
+  if (start)
+    memset((void *)start, 0, n);
+  return (uint8_t *)start;
+}
+
+#else
+
+constexpr int MAX_BLOCKS = sizeof(arena.blocks) / sizeof(arena.blocks[0]);
+
+uint8_t *arenaAlloc(unsigned long n) {
+  if (arena.count == MAX_BLOCKS)
+    return nullptr;
+  void *p = calloc(n ? n : 1, 1);
+  if (p)
+    arena.blocks[arena.count++] = p;
+  return (uint8_t *)p;
+}
+
+uint8_t *arenaGrow(uint8_t *p, unsigned long size, unsigned long n) {
+  if (!p || arena.count == 0 || arena.blocks[arena.count - 1] != p)
+    return nullptr;
+  uint8_t *q = (uint8_t *)realloc(p, n ? n : 1);
+  if (!q)
+    return nullptr;
+  if (n > size)
+    memset(q + size, 0, n - size);
+  arena.blocks[arena.count - 1] = q;
+  return q;
+}
+
+void arenaReset() {
+  while (arena.count > 0)
+    free(arena.blocks[--arena.count]);
+}
+
+uint8_t *permanentAlloc(unsigned long n) {
+  return (uint8_t *)calloc(n ? n : 1, 1);
+}
+
+#endif
+
+bool arenaGrid(Grid *grid, int width, int height) {
+  grid->cells = arenaAlloc((unsigned long)width * height);
+  grid->stride = height;
+  return grid->cells != nullptr;
+}
@@ -7,7 +7,7 @@
 #include "mouse.h"
 #include "platform.h"
 
-extern TMouse mouse;
+extern TMouse &mouse;
 
 /**
  * @brief Construct a new TButton with default white icon
@@ -26,38 +26,56 @@ TButton::TButton() {
 void TButton::setBlitMap(void *map) { memcpy(blitMap, map, sizeof(blitMap)); }
 
 /**
- * @brief Render the button with 3D border effect and icon
+ * @brief Pre-render both states with 3D border effect and icon
  *
  * The button draws with a beveled edge effect:
  * - When up: top/left edges are light, bottom/right are dark
  * - When down: colors are swapped for pressed appearance
+ *
+ * Icon pixels outside the button rectangle are dropped; in the original
+ * drawing they were all transparent.
  */
-void TButton::paint() {
-  mouse.hide();
+void TButton::buildSprites() {
+  int w = x2 - x1 + 1, h = y2 - y1 + 1;
+  if (w > BUTTON_SPRITE_SIZE)
+    w = BUTTON_SPRITE_SIZE;
+  if (h > BUTTON_SPRITE_SIZE)
+    h = BUTTON_SPRITE_SIZE;
 
-  // Draw 3D border effect
-  if (isDown == 0) {
-    // Button is up - light top/left, dark bottom/right
-    drawline(x1, y1, x2, y1, DARKGRAY);
-    drawline(x1, y1, x1, y2, DARKGRAY);
-    drawline(x2, y2, x2, y1, 0);
-    drawline(x2, y2, x1, y2, 0);
-  } else {
-    // Button is down - dark top/left, light bottom/right
-    drawline(x1, y1, x2, y1, 0);
-    drawline(x1, y1, x1, y2, 0);
-    drawline(x2, y2, x2, y1, DARKGRAY);
-    drawline(x2, y2, x1, y2, DARKGRAY);
-  }
+  for (int down = 0; down < 2; down++) {
+    uint32_t *sprite = sprites[down];
+    uint32_t light = paletteColor(down ? 0 : DARKGRAY);
+    uint32_t dark = paletteColor(down ? DARKGRAY : 0);
 
-  // Blit the icon (color 16 = transparent)
-  for (int x = 0; x < 16; x++) {
-    for (int y = 0; y < 16; y++) {
-      if (blitMap[x][y] != 16) {
-        putpixel(x1 + 1 + x, y1 + 1 + y, blitMap[x][y]);
-      }
+    // Top/left edges first; bottom/right win the two shared corners
+    for (int x = 0; x < w; x++) {
+      sprite[x] = light;
+      sprite[(h - 1) * w + x] = dark;
+    }
+    for (int y = 0; y < h - 1; y++) {
+      sprite[y * w] = light;
+      sprite[y * w + w - 1] = dark;
     }
+
+    // Icon (color 16 = transparent)
+    for (int x = 0; x < 16 && x + 1 < w; x++)
+      for (int y = 0; y < 16 && y + 1 < h; y++)
+        if (blitMap[x][y] != 16)
+          sprite[(y + 1) * w + x + 1] = paletteColor(blitMap[x][y]);
   }
+  paintedDown = -1;
+}
 
+void TButton::paint() {
+  mouse.hide();
+  int w = x2 - x1 + 1, h = y2 - y1 + 1;
+  blit(x1, y1, w < BUTTON_SPRITE_SIZE ? w : BUTTON_SPRITE_SIZE,
+       h < BUTTON_SPRITE_SIZE ? h : BUTTON_SPRITE_SIZE, sprites[isDown != 0]);
+  paintedDown = isDown;
   mouse.show();
 }
+
+void TButton::refresh() {
+  if (isDown != paintedDown)
+    paint();
+}
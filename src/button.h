@@ -3,7 +3,8 @@
  * @brief UI Button component for the sidebar
  *
  * Provides a simple button class with icon support, toggle state,
- * and 3D-style pressed/unpressed rendering.
+ * and 3D-style pressed/unpressed rendering. Both looks are pre-rendered into
+ * RGBA sprites, so redrawing a button is a handful of row copies.
  */
 
 #ifndef BUTTON_H
@@ -11,6 +12,8 @@
 
 #include "platform.h"
 
+constexpr int BUTTON_SPRITE_SIZE = 18; ///< Largest button width and height
+
 /**
  * @class TButton
  * @brief Represents a clickable UI button with an icon
@@ -31,13 +34,19 @@ public:
   void setBlitMap(void *map);
 
   /**
-   * @brief Render the button to the screen
+   * @brief Pre-render the up and down sprites
    *
-   * Draws the button border (3D effect based on isDown state)
-   * and blits the icon on top.
+   * Draws the button border (3D effect for each state) with the icon on top
+   * into the sprites. Call after the rectangle, icon or palette change.
    */
+  void buildSprites();
+
+  /// Blit the sprite for the current isDown state to the screen
   void paint();
 
+  /// Paint the button only if isDown changed since it was last painted
+  void refresh();
+
   // Button rectangle (screen coordinates)
   int x1 = 0, y1 = 0, x2 = 0, y2 = 0;
 
@@ -47,6 +56,10 @@ public:
 
 private:
   uint8_t blitMap[16][16]; ///< 16x16 icon bitmap (color indices)
+
+  /// Up and down looks, row-major, (x2 - x1 + 1) pixels per row
+  uint32_t sprites[2][BUTTON_SPRITE_SIZE * BUTTON_SPRITE_SIZE];
+  int paintedDown = -1; ///< isDown when last painted, -1 if not on screen
 };
 
 #endif
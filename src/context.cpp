@@ -0,0 +1,267 @@
+/**
+ * @file context.cpp
+ * @brief Switching between simulation worlds (see slime.h)
+ *
+ * The engine works on globals: the kernels, the renderer and the browser
+ * exports all address "the" field, and keeping it that way costs nothing
+ * in the hot loops. A SimContext holds a saved copy of every module's
+ * per-world state. makeCurrent() saves the live state into the world that
+ * owns it and loads the next one, so whichever world is current runs
+ * exactly the code the single-world build runs. The price is that there is
+ * only ever one live world, and switching is not thread-safe: see slime.h.
+ *
+ * The module starts with its own world already live; the page's exports
+ * (init(), advance(), render(), ...) act on whichever world is current,
+ * which is that one unless a slime_* call is in progress.
+ */
+
+#include "slime.h"
+#include "game.h"
+#include "history.h"
+#include "input.h"
+#include "replay.h"
+#include "rng.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "threads.h"
+#include "walls.h"
+
+struct SimContext {
+  ArenaState arena;
+  EngineState engine;
+  SimState sim;
+  SnapshotState snapshot;
+  ReplayState replay;
+  HistoryState history;
+  WallPlane walls;
+  RngState rng;
+  InputQueue input;
+  SimContext *nextFree = nullptr; ///< Free list link (WASM)
+};
+
+/// Storage for the module's own world while another one is current
+static SimContext default_context;
+
+static SimContext *current = &default_context;
+
+#if defined(__wasm__)
+/// Linear memory cannot be returned, so destroyed contexts are reused
+static SimContext *free_contexts = nullptr;
+#endif
+
+/// Save the live state into the current world and load ctx
+static void makeCurrent(SimContext *ctx) {
+  if (ctx == current)
+    return;
+  saveArenaState(&current->arena);
+  saveEngineState(&current->engine);
+  saveSimState(&current->sim);
+  saveSnapshotState(&current->snapshot);
+  saveReplayState(&current->replay);
+  saveHistoryState(&current->history);
+  current->walls = walls;
+  saveRandomState(&current->rng);
+  current->input = inputQueue;
+
+  loadArenaState(ctx->arena);
+  loadEngineState(ctx->engine);
+  loadSimState(ctx->sim);
+  loadSnapshotState(ctx->snapshot);
+  loadReplayState(ctx->replay);
+  loadHistoryState(ctx->history);
+  walls = ctx->walls;
+  loadRandomState(ctx->rng);
+  inputQueue = ctx->input;
+  current = ctx;
+}
+
+extern "C" {
+
+SimContext *slime_create(int width, int height) {
+  SimContext *ctx = nullptr;
+#if defined(__wasm__)
+  if (free_contexts) {
+    ctx = free_contexts;
+    free_contexts = ctx->nextFree;
+  }
+#endif
+  if (!ctx)
+    ctx = (SimContext *)permanentAlloc(sizeof(SimContext));
+  if (!ctx)
+    return nullptr;
+  new (ctx) SimContext();
+
+  SimContext *previous = current;
+  makeCurrent(ctx);
+  seedRandom(0);
+  bool ok = init(width, height);
+  makeCurrent(previous);
+  if (!ok) {
+    slime_destroy(ctx);
+    return nullptr;
+  }
+  return ctx;
+}
+
+void slime_destroy(SimContext *ctx) {
+  if (!ctx || ctx == &default_context)
+    return;
+  SimContext *previous = current == ctx ? &default_context : current;
+  makeCurrent(ctx);
+  arenaReset();
+  makeCurrent(previous);
+#if defined(__wasm__)
+  ctx->nextFree = free_contexts;
+  free_contexts = ctx;
+#else
+  free(ctx);
+#endif
+}
+
+int slime_field_width(SimContext *ctx) {
+  makeCurrent(ctx);
+  return fieldWidth;
+}
+
+int slime_field_height(SimContext *ctx) {
+  makeCurrent(ctx);
+  return fieldHeight;
+}
+
+int slime_screen_width(SimContext *ctx) {
+  makeCurrent(ctx);
+  return screenWidth;
+}
+
+int slime_screen_height(SimContext *ctx) {
+  makeCurrent(ctx);
+  return screenHeight;
+}
+
+void slime_seed(SimContext *ctx, uint32_t seed) {
+  makeCurrent(ctx);
+  seed_random(seed);
+}
+
+void slime_reset(SimContext *ctx) {
+  makeCurrent(ctx);
+  n();
+}
+
+void slime_set_rain(SimContext *ctx, int enabled) {
+  makeCurrent(ctx);
+  game.rainmode = enabled != 0;
+}
+
+void slime_set_paused(SimContext *ctx, int paused) {
+  makeCurrent(ctx);
+  game.paused = paused != 0;
+}
+
+void slime_set_sim_mode(SimContext *ctx, int mode) {
+  makeCurrent(ctx);
+  set_sim_mode(mode);
+}
+
+void slime_set_param(SimContext *ctx, int param, int value) {
+  makeCurrent(ctx);
+  set_param(param, value);
+}
+
+int slime_get_param(SimContext *ctx, int param) {
+  makeCurrent(ctx);
+  return get_param(param);
+}
+
+void slime_set_temporal_steps(SimContext *ctx, int k) {
+  makeCurrent(ctx);
+  set_temporal_steps(k);
+}
+
+void slime_set_sleep_tiles(SimContext *ctx, int enabled) {
+  makeCurrent(ctx);
+  set_sleep_tiles(enabled);
+}
+
+void slime_set_speed(SimContext *ctx, double speed) {
+  makeCurrent(ctx);
+  set_speed(speed);
+}
+
+void slime_draw_wall(SimContext *ctx, int x1, int y1, int x2, int y2) {
+  makeCurrent(ctx);
+  logic_line(x1, y1, x2, y2, 1);
+}
+
+void slime_fill_water(SimContext *ctx, int x1, int y1, int x2, int y2,
+                      int density) {
+  makeCurrent(ctx);
+  if (density < 0)
+    density = 0;
+  if (density > simParams.maxWater)
+    density = simParams.maxWater;
+  if (x1 > x2)
+    swap(&x1, &x2);
+  if (y1 > y2)
+    swap(&y1, &y2);
+  for (int x = x1 < 1 ? 1 : x1; x <= x2 && x < fieldWidth - 1; x++)
+    for (int y = y1 < 1 ? 1 : y1; y <= y2 && y < fieldHeight - 1; y++)
+      if (field[x][y] < WALL_VALUE)
+        field[x][y] = density;
+  wakeRect(x1, y1, x2, y2);
+}
+
+int slime_cell(SimContext *ctx, int x, int y) {
+  makeCurrent(ctx);
+  return inScreen(x, y) ? field[x][y] : -1;
+}
+
+int slime_pointer(SimContext *ctx, int pointer, int x, int y, int buttons) {
+  makeCurrent(ctx);
+  return pushInputEvent(get_time_ms(), pointer, x, y, buttons);
+}
+
+int slime_step(SimContext *ctx, int n) {
+  makeCurrent(ctx);
+  return step_many(n);
+}
+
+int slime_advance(SimContext *ctx, double elapsed_ms) {
+  makeCurrent(ctx);
+  return advance(elapsed_ms);
+}
+
+int slime_fast_forward(SimContext *ctx, int steps, double time_budget_ms) {
+  makeCurrent(ctx);
+  return fast_forward(steps, time_budget_ms);
+}
+
+int slime_save_snapshot(SimContext *ctx, const uint8_t **data) {
+  makeCurrent(ctx);
+  *data = get_snapshot_buffer();
+  return save_snapshot();
+}
+
+int slime_load_snapshot(SimContext *ctx, const uint8_t *data, int size) {
+  makeCurrent(ctx);
+  return loadSnapshot(data, size);
+}
+
+int slime_is_idle(SimContext *ctx) {
+  makeCurrent(ctx);
+  return is_idle();
+}
+
+void slime_render(SimContext *ctx) {
+  makeCurrent(ctx);
+  render();
+}
+
+const uint8_t *slime_frame(SimContext *ctx) {
+  makeCurrent(ctx);
+  return video_buffer;
+}
+
+void slime_set_thread_count(int n) { setThreadCount(n); }
+
+} // extern "C"
@@ -0,0 +1,191 @@
+/**
+ * @file game.h
+ * @brief Game state and the exported engine API
+ *
+ * Declares the state structs, global instances and C entry points defined
+ * in main.cpp, so that the native tools in tools/ can drive exactly the same
+ * code that the browser does.
+ */
+
+#ifndef GAME_H
+#define GAME_H
+
+#include "button.h"
+#include "mouse.h"
+#include "platform.h"
+#include "sim.h"
+
+// =============================================================================
+// Enums for Type-Safe Constants
+// =============================================================================
+
+/// Tools available in the sidebar (indices 1-5)
+enum class Tool {
+  Pencil = 1,      ///< Draw walls
+  EraserWall = 2,  ///< Erase walls
+  EraserWater = 3, ///< Erase water
+  Line = 4,        ///< Line drawing mode
+  Free = 5         ///< Freehand drawing mode
+};
+
+/// Actions triggered by sidebar buttons
+enum class Action {
+  Reset = 10,      ///< Reset simulation
+  Pause = 11,      ///< Pause/resume
+  ClearLines = 12, ///< Clear all walls
+  ClearWater = 13, ///< Clear all water
+  Rain = 22        ///< Toggle rain mode
+};
+
+/// Current eraser tool mode
+enum class EraserMode { None = 0, Wall = 1, Water = 2 };
+
+// =============================================================================
+// State Structs
+// =============================================================================
+
+/**
+ * @brief Global game state variables
+ */
+struct GameState {
+  EraserMode eraser = EraserMode::None; ///< Current eraser mode
+  int drawmode = 1;                     ///< 1 = Line mode, 2 = Freehand mode
+  bool rainmode = false;                ///< Rain enabled
+  bool paused = false;                  ///< Simulation paused
+  int frames = 0;                       ///< Frame counter
+  double speed = 1.0;                   ///< Simulation speed multiplier
+  double stepDebt = 0;                  ///< Elapsed time not yet stepped (ms)
+};
+
+/**
+ * @brief Input state for drawing operations, one per pointer
+ */
+struct InputState {
+  bool hasLeft = false; ///< Left button was pressed (tracking drag start)
+  bool mayDraw = true;  ///< Drawing is allowed
+  int x1 = 0, y1 = 0;   ///< Drag start position
+  EraserMode eraser = EraserMode::None; ///< Tool when a button went down
+  int drawmode = 1;                     ///< Draw mode when a button went down
+};
+
+constexpr int MAX_POINTERS = 10; ///< Mouse or primary touch, plus 9 touches
+
+/**
+ * @brief One pointer: its position and buttons, and the stroke it is drawing
+ *
+ * Pointer 0 is the mouse (or the primary touch) and draws the cursor. Each
+ * pointer keeps the tool that was selected when its button went down, so
+ * several people can draw at once without one tool change cutting across
+ * another's stroke.
+ */
+struct Pointer {
+  TMouse mouse;
+  InputState input;
+};
+
+// =============================================================================
+// Global State (defined in main.cpp)
+// =============================================================================
+
+/// RGBA video buffer - written by C++, read by JavaScript for canvas rendering
+/// (screenWidth x screenHeight, row-major)
+extern uint8_t *video_buffer;
+
+/// Simulation field: each cell is water density (0-97), wall (99), or drain
+/// (100). Sized screenWidth x screenHeight by init().
+extern Grid field;
+
+extern GameState game;
+extern Pointer pointers[MAX_POINTERS];
+extern TMouse &mouse; ///< pointers[0].mouse
+
+/**
+ * @brief Everything main.cpp keeps for one world (see context.cpp)
+ *
+ * Defaults match a freshly loaded module.
+ */
+struct EngineState {
+  int fieldWidth = DEFAULT_FIELD_WIDTH, fieldHeight = DEFAULT_FIELD_HEIGHT;
+  int screenWidth = DEFAULT_FIELD_WIDTH + SIDEBAR_WIDTH;
+  int screenHeight = DEFAULT_FIELD_HEIGHT;
+  uint8_t *video_buffer = nullptr;
+  Grid field;
+  GameState game;
+  Pointer pointers[MAX_POINTERS];
+  int queued_x = 0, queued_y = 0, queued_btn = 0;
+  TButton buttons[10];
+  bool uiBuilt = false;
+  int8_t buttonAtRow[MIN_FIELD_HEIGHT] = {};
+  int dirtyRects[MAX_DIRTY_RECTS * 4] = {};
+  int dirtyCount = 0;
+};
+
+/// Copy the live engine state out (to switch worlds) and back in
+void saveEngineState(EngineState *state);
+void loadEngineState(const EngineState &state);
+
+// =============================================================================
+// Game Logic (main.cpp)
+// =============================================================================
+
+/// Reset the field to an empty basin with border walls
+void n(void);
+
+/// Remove all interior walls
+void clearLines();
+
+/// Remove all water
+void clearWater();
+
+/// Draw a line into the field (st == 1) or onto the screen (st = colour)
+void logic_line(float zx1, float zy1, float zx2, float zy2, int st);
+
+/// Apply one frame's pointer events, then the last state of the pointers
+/// without events (see processInput(); the replayer calls it directly)
+void applyInput(const struct InputEvent *events, int count);
+
+/// Press the sidebar tool buttons that match game.eraser and game.drawmode
+void syncToolButtons();
+
+// =============================================================================
+// Exported API (called from JavaScript)
+// =============================================================================
+extern "C" {
+int init(int width, int height);
+int get_screen_width();
+int get_screen_height();
+uint8_t *get_video_buffer();
+void set_mouse_pos(int x, int y);
+void set_mouse_button(int btn);
+int get_max_pointers();
+struct InputQueue *get_input_queue();
+int get_input_queue_size();
+void set_sim_mode(int mode);
+int get_sim_mode();
+void set_param(int param, int value);
+int get_param(int param);
+void set_temporal_steps(int k);
+int get_temporal_steps();
+void set_sleep_tiles(int enabled);
+void set_thread_count(int n);
+int get_thread_count();
+#if defined(SLIME_THREADS) && defined(__wasm__)
+void worker_main(int id);
+uint8_t *worker_stack_top(int id);
+#endif
+void update();
+int step_many(int n);
+int advance(double elapsed_ms);
+int is_idle();
+int fast_forward(int steps, double time_budget_ms);
+int get_changed_tiles();
+void seed_random(uint32_t seed);
+uint32_t get_random_seed();
+void set_speed(double speed);
+double get_speed();
+void render();
+int get_dirty_rect_count();
+int *get_dirty_rects();
+}
+
+#endif
@@ -0,0 +1,463 @@
+/**
+ * @file history.cpp
+ * @brief Rewind history: entry coding, the entry ring and the exported API
+ *
+ * See history.h for what an entry holds.
+ */
+
+#include "history.h"
+#include "game.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "walls.h"
+
+/// Bytes of history memory per index slot; entries are rarely smaller
+constexpr int HISTORY_ENTRY_BYTES = 256;
+
+/// Runs shorter than this are written as single cells (as in snapshots)
+constexpr int MIN_RUN = 3;
+
+/// Decoding a keyframe costs about as much as this many deltas
+constexpr int KEY_DECODE_COST = 4;
+
+/// One entry: where its bytes are and which step it holds
+struct HistoryEntry {
+  int offset, size; ///< In the data area
+  int step;         ///< Step counter
+  bool key;         ///< Holds its cells as well as the delta
+};
+
+static int history_limit = HISTORY_DEFAULT_LIMIT;
+static uint8_t *history_buf;
+static int history_capacity;
+static Grid history_cells; ///< Cells of the entry at the cursor
+static HistoryEntry *history_entries;
+static int entry_capacity;
+static uint8_t *history_data;
+static int data_capacity, data_start, data_end;
+static int history_first, history_count, history_cursor = -1;
+
+void saveHistoryState(HistoryState *state) {
+  state->limit = history_limit;
+  state->buffer = history_buf;
+  state->capacity = history_capacity;
+  state->cells = history_cells;
+  state->entries = history_entries;
+  state->entryCapacity = entry_capacity;
+  state->data = history_data;
+  state->dataCapacity = data_capacity;
+  state->dataStart = data_start;
+  state->dataEnd = data_end;
+  state->first = history_first;
+  state->count = history_count;
+  state->cursor = history_cursor;
+}
+
+void loadHistoryState(const HistoryState &state) {
+  history_limit = state.limit;
+  history_buf = state.buffer;
+  history_capacity = state.capacity;
+  history_cells = state.cells;
+  history_entries = state.entries;
+  entry_capacity = state.entryCapacity;
+  history_data = state.data;
+  data_capacity = state.dataCapacity;
+  data_start = state.dataStart;
+  data_end = state.dataEnd;
+  history_first = state.first;
+  history_count = state.count;
+  history_cursor = state.cursor;
+}
+
+void resetHistory() {
+  HistoryState state;
+  state.limit = history_limit;
+  loadHistoryState(state);
+}
+
+/// Entry i, counting from the oldest
+static HistoryEntry &entry(int i) {
+  return history_entries[(history_first + i) % entry_capacity];
+}
+
+/**
+ * @brief Lay out the cells, the index and the data area in the history
+ * memory, taking it from the arena if there is not enough yet
+ *
+ * The arena cannot free, so the memory is taken once and only grown while
+ * it is the arena's last allocation; otherwise the history makes do with
+ * what it has. The cells start out as the field, so the first push has
+ * nothing to compare.
+ */
+static bool allocateHistory() {
+  if (!history_buf) {
+    history_buf = arenaAlloc((unsigned long)history_limit);
+    history_capacity = history_buf ? history_limit : 0;
+  } else if (history_capacity < history_limit) {
+    uint8_t *grown = arenaGrow(history_buf, (unsigned long)history_capacity,
+                               (unsigned long)history_limit);
+    if (grown) {
+      history_buf = grown;
+      history_capacity = history_limit;
+    }
+  }
+  int size = history_capacity < history_limit ? history_capacity
+                                               : history_limit;
+  int cellBytes = (fieldWidth * fieldHeight + 7) & ~7;
+  entry_capacity = size / HISTORY_ENTRY_BYTES;
+  int indexBytes = entry_capacity * (int)sizeof(HistoryEntry);
+  data_capacity = size - cellBytes - indexBytes;
+  if (!history_buf || entry_capacity < 2 || data_capacity < 1024) {
+    history_data = nullptr;
+    return false;
+  }
+  history_cells.cells = history_buf;
+  history_cells.stride = fieldHeight;
+  history_entries = (HistoryEntry *)(history_buf + cellBytes);
+  history_data = history_buf + cellBytes + indexBytes;
+  data_start = data_end = 0;
+  history_first = history_count = 0;
+  history_cursor = -1;
+  for (int x = 0; x < fieldWidth; x++)
+    memcpy(history_cells[x], field[x], fieldHeight);
+  markAllSaved(UNSAVED_HISTORY);
+  return true;
+}
+
+// =============================================================================
+// Entry Coding
+// =============================================================================
+
+/// Bounded writer; writing past the end clears ok
+struct Output {
+  uint8_t *p, *end;
+  bool ok = true;
+
+  void u8(int v) {
+    if (p < end)
+      *p++ = (uint8_t)v;
+    else
+      ok = false;
+  }
+  void u32(uint32_t v) {
+    for (int i = 0; i < 4; i++)
+      u8((int)(v >> (8 * i)));
+  }
+};
+
+/// Run-length coder for cell bytes below 0x80 (see snapshot.h)
+struct RunCoder {
+  Output &w;
+  int value = -1;
+  unsigned run = 0;
+
+  void put(int v) {
+    if (v == value) {
+      run++;
+      return;
+    }
+    flush();
+    value = v;
+    run = 1;
+  }
+  void repeat(int v, unsigned n) {
+    if (v != value) {
+      flush();
+      value = v;
+      run = 0;
+    }
+    run += n;
+  }
+  void flush() {
+    if (run >= MIN_RUN) {
+      w.u8(0x80 | value);
+      for (unsigned count = run - MIN_RUN;; count >>= 7) {
+        w.u8((count & 0x7F) | (count > 0x7F ? 0x80 : 0));
+        if (count <= 0x7F)
+          break;
+      }
+    } else {
+      for (unsigned i = 0; i < run; i++)
+        w.u8(value);
+    }
+    run = 0;
+  }
+};
+
+/// Code the field's cells xor the cursor's; tiles that did not change since
+/// the last push are known to be 0 and not read
+static void encodeDelta(Output &w) {
+  RunCoder coder{w};
+  for (int x = 0; x < fieldWidth; x++) {
+    const uint8_t *column = field[x], *previous = history_cells[x];
+    int tx = x / TILE_SIZE;
+    for (int y0 = 0; y0 < fieldHeight; y0 += TILE_SIZE) {
+      int y1 = y0 + TILE_SIZE < fieldHeight ? y0 + TILE_SIZE : fieldHeight;
+      if (!tileUnsaved(tx, y0 / TILE_SIZE, UNSAVED_HISTORY)) {
+        coder.repeat(0, y1 - y0);
+        continue;
+      }
+      for (int y = y0; y < y1; y++)
+        coder.put(column[y] ^ previous[y]);
+    }
+  }
+  coder.flush();
+}
+
+/// Code the field's cells
+static void encodeKey(Output &w) {
+  RunCoder coder{w};
+  for (int x = 0; x < fieldWidth; x++) {
+    const uint8_t *column = field[x];
+    for (int y = 0; y < fieldHeight; y++)
+      coder.put(column[y]);
+  }
+  coder.flush();
+}
+
+/// Decode cells into the cursor's, xoring them in for a delta; false if
+/// the stream is malformed
+static bool decodeCells(const uint8_t *p, const uint8_t *end, bool delta) {
+  const int height = fieldHeight;
+  long total = (long)fieldWidth * height, k = 0;
+  while (k < total) {
+    if (p >= end)
+      return false;
+    int token = *p++;
+    int value = token & 0x7F;
+    long run = 1;
+    if (token & 0x80) {
+      unsigned count = 0;
+      for (int shift = 0; shift < 28; shift += 7) {
+        int b = p < end ? *p++ : 0;
+        count |= (unsigned)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+          break;
+      }
+      run = (long)count + MIN_RUN;
+    }
+    if (run > total - k)
+      return false;
+    if (delta && value == 0) {
+      k += run; // unchanged
+      continue;
+    }
+    int x = (int)(k / height), y = (int)(k % height);
+    uint8_t *column = history_cells[x];
+    for (k += run; run > 0; run--) {
+      column[y] = delta ? column[y] ^ value : value;
+      if (++y == height) {
+        y = 0;
+        column = history_cells[++x];
+      }
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Write the entry for the world as it is into [out, end); returns
+ * its size, or 0 if it does not fit
+ *
+ * Layout: u16 size and the game state record, u32 size and the delta, then
+ * for a keyframe the cells.
+ */
+static int writeEntry(uint8_t *out, uint8_t *end, bool key) {
+  Output w{out, end};
+  int stateSize = save_game_state();
+  w.u8(stateSize);
+  w.u8(stateSize >> 8);
+  if (end - w.p >= stateSize) {
+    memcpy(w.p, get_snapshot_buffer(), stateSize);
+    w.p += stateSize;
+  } else {
+    w.ok = false;
+  }
+  uint8_t *deltaSize = w.p;
+  w.u32(0);
+  if (history_count > 0)
+    encodeDelta(w);
+  if (!w.ok)
+    return 0;
+  Output{deltaSize, end}.u32((uint32_t)(w.p - deltaSize - 4));
+  if (key)
+    encodeKey(w);
+  return w.ok ? (int)(w.p - out) : 0;
+}
+
+/// Parts of entry i: its game state record, delta and keyframe cells
+struct EntryParts {
+  const uint8_t *state, *delta, *cells, *end;
+  int stateSize, deltaSize;
+};
+
+static EntryParts entryParts(int i) {
+  const HistoryEntry &e = entry(i);
+  EntryParts parts;
+  const uint8_t *p = history_data + e.offset;
+  parts.end = p + e.size;
+  parts.stateSize = p[0] | p[1] << 8;
+  parts.state = p + 2;
+  p = parts.state + parts.stateSize;
+  parts.deltaSize = (int)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+  parts.delta = p + 4;
+  parts.cells = parts.delta + parts.deltaSize;
+  return parts;
+}
+
+// =============================================================================
+// Entry Ring
+// =============================================================================
+
+static void dropOldest() {
+  history_first = (history_first + 1) % entry_capacity;
+  history_count--;
+  history_cursor--;
+  data_start = history_count > 0 ? entry(0).offset : data_end;
+}
+
+/// Drop the oldest entry, and more until at most half the data area is in
+/// use, and move the rest to its start
+static void makeRoom() {
+  do
+    dropOldest();
+  while (history_count > 0 && data_end - data_start > data_capacity / 2);
+  if (history_count == 0)
+    data_start = data_end;
+  int used = data_end - data_start;
+  memmove(history_data, history_data + data_start, used);
+  for (int i = 0; i < history_count; i++)
+    entry(i).offset -= data_start;
+  data_start = 0;
+  data_end = used;
+}
+
+/// True if none of the newest HISTORY_KEY_INTERVAL - 1 entries is a keyframe
+static bool keyDue() {
+  for (int i = history_count - 1;
+       i >= 0 && i > history_count - HISTORY_KEY_INTERVAL; i--)
+    if (entry(i).key)
+      return false;
+  return true;
+}
+
+/// Move the cursor's cells to entry `index`, one delta per entry, or from
+/// the nearest keyframe if that is closer
+static void walkTo(int index) {
+  int best = -1;
+  for (int i = 0; i < history_count; i++)
+    if (entry(i).key && (best < 0 || abs(i - index) < abs(best - index)))
+      best = i;
+  if (best >= 0 &&
+      abs(best - index) + KEY_DECODE_COST < abs(history_cursor - index)) {
+    EntryParts parts = entryParts(best);
+    decodeCells(parts.cells, parts.end, false);
+    history_cursor = best;
+  }
+  // A delta turns the cells of its entry into those of the one before
+  while (history_cursor > index) {
+    EntryParts parts = entryParts(history_cursor--);
+    decodeCells(parts.delta, parts.delta + parts.deltaSize, true);
+  }
+  while (history_cursor < index) {
+    EntryParts parts = entryParts(++history_cursor);
+    decodeCells(parts.delta, parts.delta + parts.deltaSize, true);
+  }
+}
+
+extern "C" {
+
+int push_history() {
+  if (history_limit <= 0 || (!history_data && !allocateHistory()))
+    return 0;
+  // Whatever was rewound past is replaced by this frame
+  if (history_cursor < history_count - 1) {
+    history_count = history_cursor + 1;
+    data_end = history_count > 0
+                   ? entry(history_count - 1).offset +
+                         entry(history_count - 1).size
+                   : data_start;
+  }
+  if (history_count == entry_capacity)
+    dropOldest();
+
+  bool key = keyDue();
+  int size;
+  while (!(size = writeEntry(history_data + data_end,
+                             history_data + data_capacity, key))) {
+    if (history_count > 0) {
+      makeRoom();
+      key = keyDue();
+    } else if (key) {
+      key = false; // the cells are only a shortcut
+    } else {
+      clear_history();
+      return 0; // too large even on its own
+    }
+  }
+
+  HistoryEntry &e = entry(history_count);
+  e.offset = data_end;
+  e.size = size;
+  e.step = game.frames;
+  e.key = key;
+  data_end += size;
+  history_cursor = history_count++;
+
+  // The cells become this entry's
+  for (int x = 0; x < fieldWidth; x++) {
+    int tx = x / TILE_SIZE;
+    for (int y0 = 0; y0 < fieldHeight; y0 += TILE_SIZE) {
+      if (!tileUnsaved(tx, y0 / TILE_SIZE, UNSAVED_HISTORY))
+        continue;
+      int n = y0 + TILE_SIZE < fieldHeight ? TILE_SIZE : fieldHeight - y0;
+      memcpy(history_cells[x] + y0, field[x] + y0, n);
+    }
+  }
+  markAllSaved(UNSAVED_HISTORY);
+  return 1;
+}
+
+int rewind_history(int index) {
+  if (index < 0 || index >= history_count)
+    return -1;
+  walkTo(index);
+  for (int x = 0; x < fieldWidth; x++) {
+    const uint8_t *cells = history_cells[x];
+    for (int y = 0; y < fieldHeight; y++)
+      if (field[x][y] != cells[y])
+        putCell(x, y, cells[y]);
+  }
+  EntryParts parts = entryParts(index);
+  loadSnapshot(parts.state, parts.stateSize);
+  wakeAll();
+  // The field is the cursor's cells again
+  markAllSaved(UNSAVED_HISTORY);
+  return entry(index).step;
+}
+
+int get_history_length() { return history_count; }
+
+int get_history_position() { return history_cursor; }
+
+int get_history_step(int index) {
+  return index >= 0 && index < history_count ? entry(index).step : -1;
+}
+
+int get_history_bytes() { return data_end - data_start; }
+
+void clear_history() {
+  history_first = history_count = 0;
+  history_cursor = -1;
+  data_start = data_end = 0;
+}
+
+void set_history_limit(int bytes) {
+  history_limit = bytes > 0 ? bytes : 0;
+  history_data = nullptr; // laid out again at the next push
+  clear_history();
+}
+
+int get_history_limit() { return history_limit; }
+
+} // extern "C"
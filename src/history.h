@@ -0,0 +1,115 @@
+/**
+ * @file history.h
+ * @brief Rewind history: the recent past of a world as a ring of deltas
+ *
+ * The host pushes the world after each frame (push_history()) and can later
+ * rewind it to any frame still held (rewind_history()), e.g. to undo a
+ * flood. Frames are not stored whole. Each entry holds:
+ *
+ * - the game state, as a 'G' snapshot record (see snapshot.h), so that the
+ *   step counter, tools and random generator rewind with the field
+ * - the XOR of its cells with those of the previous entry, run-length coded
+ *   like snapshot cells (the XOR of two cell values stays below 0x80, and
+ *   unchanged cells make long runs of 0)
+ * - for every HISTORY_KEY_INTERVAL-th entry (a keyframe), also its cells
+ *
+ * An XOR delta works both ways: applied to the cells of its entry it gives
+ * those of the entry before, and applied to those it gives them back. The
+ * cells of one entry (the cursor) are kept decoded, and rewinding walks
+ * from there one delta per frame, or from the nearest keyframe if that is
+ * closer. Only tiles that changed since the last push (see tileUnsaved() in
+ * sim.h) are compared, so a push costs little more than the cells that
+ * moved.
+ *
+ * The entries live in one buffer of set_history_limit() bytes, together
+ * with the decoded cells and the entry index. When it is full the oldest
+ * entries are dropped; the newest one never needs them, as it is always
+ * reachable through the deltas.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include "platform.h"
+
+/// Memory for the history of one world, unless set_history_limit() changes it
+constexpr int HISTORY_DEFAULT_LIMIT = 8 << 20;
+
+/// Entries from one keyframe to the next
+constexpr int HISTORY_KEY_INTERVAL = 60;
+
+/// Forget the history; the arena is reset. Called by init().
+void resetHistory();
+
+/// Rewind history of one world (see context.cpp)
+struct HistoryState {
+  int limit = HISTORY_DEFAULT_LIMIT;
+  uint8_t *buffer = nullptr;
+  int capacity = 0;
+  Grid cells;
+  struct HistoryEntry *entries = nullptr;
+  int entryCapacity = 0;
+  uint8_t *data = nullptr;
+  int dataCapacity = 0, dataStart = 0, dataEnd = 0;
+  int first = 0, count = 0, cursor = -1;
+};
+
+/// Copy the live history state out (to switch worlds) and back in
+void saveHistoryState(HistoryState *state);
+void loadHistoryState(const HistoryState &state);
+
+// =============================================================================
+// Exported API (called from JavaScript)
+// =============================================================================
+//
+// Entries are numbered from 0, the oldest held, to get_history_length() - 1.
+
+extern "C" {
+/**
+ * @brief Add the world as it is now as the newest entry; returns 1, or 0 if
+ * the history is off or cannot hold even this frame
+ *
+ * After a rewind the entries past the cursor are dropped first, so the
+ * world goes on from the frame it was rewound to.
+ */
+int push_history();
+
+/**
+ * @brief Restore the field and game state of entry `index`; returns its
+ * step counter, or -1 if there is no such entry
+ *
+ * Pointers and anything not pushed since the last push_history() are not
+ * part of the history and stay as they are.
+ */
+int rewind_history(int index);
+
+/// Number of entries held
+int get_history_length();
+
+/// Entry the world was last pushed or rewound to, -1 if none
+int get_history_position();
+
+/// Step counter of entry `index`, -1 if there is no such entry
+int get_history_step(int index);
+
+/// Bytes the entries take up
+int get_history_bytes();
+
+/// Drop every entry
+void clear_history();
+
+/**
+ * @brief Set the memory for the history, in bytes, and drop every entry;
+ * 0 turns the history off
+ *
+ * The memory is taken from the arena at the next push and returned only by
+ * init(). It is taken once: a larger limit grows it only while nothing else
+ * has been allocated after it, and otherwise the history keeps to the
+ * memory it already has.
+ */
+void set_history_limit(int bytes);
+
+int get_history_limit();
+}
+
+#endif
@@ -0,0 +1,32 @@
+/**
+ * @file input.cpp
+ * @brief Pointer event queue
+ */
+
+#include "input.h"
+
+InputQueue inputQueue;
+
+bool pushInputEvent(double time, int pointer, int x, int y, int buttons) {
+  uint32_t head = inputQueue.head;
+  if (head - __atomic_load_n(&inputQueue.tail, __ATOMIC_ACQUIRE) >=
+      (uint32_t)INPUT_QUEUE_SIZE)
+    return false;
+  InputEvent &e = inputQueue.events[head % INPUT_QUEUE_SIZE];
+  e.time = time;
+  e.x = x;
+  e.y = y;
+  e.buttons = buttons;
+  e.pointer = pointer;
+  __atomic_store_n(&inputQueue.head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool popInputEvent(InputEvent *event) {
+  uint32_t tail = inputQueue.tail;
+  if (tail == __atomic_load_n(&inputQueue.head, __ATOMIC_ACQUIRE))
+    return false;
+  *event = inputQueue.events[tail % INPUT_QUEUE_SIZE];
+  __atomic_store_n(&inputQueue.tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file input.h
+ * @brief Ring buffer of pointer events written by the host
+ *
+ * The host appends timestamped pointer samples (including the coalesced
+ * samples browsers collect between frames) straight into this queue in
+ * linear memory, and processInput() drains them in order at the start of
+ * the next frame. Quick clicks and fast strokes therefore survive intact,
+ * and a frame's worth of events costs no calls into the module beyond the
+ * usual advance().
+ *
+ * head and tail count events written and read since startup; slot
+ * `i % INPUT_QUEUE_SIZE` holds event i. Only the host advances head and only
+ * the module advances tail, so the queue needs no locking.
+ */
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include "platform.h"
+
+constexpr int INPUT_QUEUE_SIZE = 1024; ///< Events held before the host drops
+
+/// One pointer sample: position in screen pixels and the full button state
+struct InputEvent {
+  double time;     ///< Host timestamp (ms)
+  int32_t x, y;    ///< Position in screen pixels
+  int32_t buttons; ///< 0 = none, 1 = left, 2 = right
+  int32_t pointer; ///< Pointer slot (0 = mouse or primary touch)
+};
+
+/// Layout shared with the host (see docs/sim.js)
+struct InputQueue {
+  uint32_t head; ///< Events written (host)
+  uint32_t tail; ///< Events read (module)
+  InputEvent events[INPUT_QUEUE_SIZE];
+};
+
+extern InputQueue inputQueue;
+
+/// Append an event from inside the module; returns false if the queue is full
+bool pushInputEvent(double time, int pointer, int x, int y, int buttons);
+
+/// Take the oldest unread event; returns false if the queue is empty
+bool popInputEvent(InputEvent *event);
+
+#endif
@@ -7,7 +7,8 @@
  * and UI handling.
  *
  * The simulation uses a cellular automata approach where each cell
- * contains a water density value (0-97) or wall marker (99).
+ * contains a water density value (0-97); walls live in a separate bitplane
+ * (walls.h) and read as 99 in the density field.
  * Water flows to neighboring cells based on density gradients.
  *
  * @author Original DOS version: Blaine Murray (http://ethercode.net/)
@@ -16,101 +17,63 @@
  */
 
 #include "button.h"
+#include "game.h"
+#include "history.h"
+#include "input.h"
 #include "mouse.h"
 #include "platform.h"
-
+#include "replay.h"
+#include "rng.h"
+#include "sim.h"
+#include "snapshot.h"
+#include "threads.h"
+#include "walls.h"
+
+#if defined(__wasm__)
 // Needed for static object destruction with -nostdlib
 extern "C" void *__dso_handle = nullptr;
 extern "C" int __cxa_atexit(void (*func)(void *), void *arg, void *dso_handle) {
   return 0;
 }
+#endif
 
 // =============================================================================
 // Global State
 // =============================================================================
 
+int fieldWidth = DEFAULT_FIELD_WIDTH;
+int fieldHeight = DEFAULT_FIELD_HEIGHT;
+int screenWidth = DEFAULT_FIELD_WIDTH + SIDEBAR_WIDTH;
+int screenHeight = DEFAULT_FIELD_HEIGHT;
+
 /// RGBA video buffer - written by C++, read by JavaScript for canvas rendering
-uint8_t video_buffer[SCREEN_WIDTH * SCREEN_HEIGHT * 4];
+uint8_t *video_buffer = nullptr;
 
 /// Simulation field: each cell is water density (0-97), wall (99), or drain
 /// (100)
-uint8_t field[SCREEN_WIDTH][SCREEN_HEIGHT];
+Grid field;
 
-/// Mouse input from JavaScript
-int input_mouse_x = 0;
-int input_mouse_y = 0;
-int input_mouse_btn = 0;
+/// Pointer state as last queued by set_mouse_pos()/set_mouse_button()
+static int queued_x = 0, queued_y = 0, queued_btn = 0;
 
 /// UI buttons (10 slots, not all used)
 TButton buttons[10];
 
-/// Global mouse state
-TMouse mouse;
-
-// =============================================================================
-// Enums for Type-Safe Constants
-// =============================================================================
-
-/// Tools available in the sidebar (indices 1-5)
-enum class Tool {
-  Pencil = 1,      ///< Draw walls
-  EraserWall = 2,  ///< Erase walls
-  EraserWater = 3, ///< Erase water
-  Line = 4,        ///< Line drawing mode
-  Free = 5         ///< Freehand drawing mode
-};
-
-/// Actions triggered by sidebar buttons
-enum class Action {
-  Reset = 10,      ///< Reset simulation
-  Pause = 11,      ///< Pause/resume
-  ClearLines = 12, ///< Clear all walls
-  ClearWater = 13, ///< Clear all water
-  Rain = 22        ///< Toggle rain mode
-};
-
-/// Current eraser tool mode
-enum class EraserMode { None = 0, Wall = 1, Water = 2 };
-
-// =============================================================================
-// State Structs
-// =============================================================================
-
-/**
- * @brief Global game state variables
- */
-struct GameState {
-  EraserMode eraser = EraserMode::None; ///< Current eraser mode
-  int drawmode = 1;                     ///< 1 = Line mode, 2 = Freehand mode
-  bool rainmode = false;                ///< Rain enabled
-  bool paused = false;                  ///< Simulation paused
-  int frames = 0;                       ///< Frame counter
-};
-
-/**
- * @brief Input state for drawing operations
- */
-struct InputState {
-  bool hasLeft = false; ///< Left button was pressed (tracking drag start)
-  bool mayDraw = true;  ///< Drawing is allowed
-  int x1 = 0, y1 = 0;   ///< Drag start position
-};
+/// Pointer state: slot 0 is the mouse (or primary touch), the rest are
+/// further touch points
+Pointer pointers[MAX_POINTERS];
+TMouse &mouse = pointers[0].mouse;
 
 // --- Global Instances ---
 GameState game;
-InputState input;
 
 // --- Graphics Implementation ---
 
 // Note: ABGR packing for little-endian WASM commonly works best with canvas
 // ImageData
 
-void putpixel(int x, int y, int c) {
-  if (x < 0 || x >= SCREEN_WIDTH || y < 0 || y >= SCREEN_HEIGHT)
-    return;
-
-  int index = (y * SCREEN_WIDTH + x) * 4;
-
+/// RGBA colour of palette index c, packed for a little-endian 32-bit store
+static uint32_t colorOf(int c) {
   uint8_t r = 0, g = 0, b = 0;
   // Basic VGA palette mapping
   switch (c % 16) {
@@ -241,10 +204,44 @@ void putpixel(int x, int y, int c) {
     }
   }
 
-  video_buffer[index] = r;
-  video_buffer[index + 1] = g;
-  video_buffer[index + 2] = b;
-  video_buffer[index + 3] = 255; // Alpha
+  return r | g << 8 | b << 16 | 0xFF000000u; // Opaque alpha
+}
+
+/// Packed colour of every palette index, built once by buildPalette()
+static uint32_t palette[256];
+
+/// Packed colour of every field cell value (empty, water, wall)
+static uint32_t cellColor[256];
+
+static void buildPalette() {
+  for (int c = 0; c < 256; c++)
+    palette[c] = colorOf(c);
+  for (int v = 0; v < 256; v++) {
+    if (v == WALL_VALUE)
+      cellColor[v] = palette[WHITE]; // White wall
+    else if (v != 0)
+      cellColor[v] = palette[(v + 1) / 2 + 103]; // Water color calculation
+    else
+      cellColor[v] = palette[0];
+  }
+}
+
+void putpixel(int x, int y, int c) {
+  if (x < 0 || x >= screenWidth || y < 0 || y >= screenHeight)
+    return;
+  ((uint32_t *)video_buffer)[y * screenWidth + x] = palette[c > 255 ? 255 : c];
+  markDirty(x, y);
+}
+
+uint32_t paletteColor(int c) { return palette[c > 255 ? 255 : c]; }
+
+void blit(int x, int y, int w, int h, const uint32_t *pixels) {
+  if (x < 0 || y < 0 || x + w > screenWidth || y + h > screenHeight)
+    return;
+  uint32_t *row = (uint32_t *)video_buffer + y * screenWidth + x;
+  for (int j = 0; j < h; j++, row += screenWidth, pixels += w)
+    memcpy(row, pixels, w * sizeof(uint32_t));
+  markDirtyRect(x, y, x + w - 1, y + h - 1);
 }
 
 void swap(int *a, int *b) {
@@ -317,6 +314,8 @@ void logic_line(float zx1, float zy1, float zx2, float zy2, int st) {
 
   if ((x1 == x2) && (y1 == y2))
     return;
+  if (st == 1)
+    wakeRect(x1, y1, x2, y2);
   float dx = x2 - x1;
   float dy = y2 - y1;
 
@@ -327,9 +326,9 @@ void logic_line(float zx1, float zy1, float zx2, float zy2, int st) {
       swap(&x1, &x2);
     for (int x = x1; x <= x2; x++) {
       cy += iy;
-      if (x >= 0 && x < 300 && (int)cy >= 0 && (int)cy < 200) {
+      if (x >= 0 && x < fieldWidth && (int)cy >= 0 && (int)cy < fieldHeight) {
         if (st == 1)
-          field[x][(int)cy] = 99;
+          setWall(x, (int)cy);
         else
           putpixel(x, (int)cy, st);
       }
@@ -344,9 +343,9 @@ void logic_line(float zx1, float zy1, float zx2, float zy2, int st) {
     }
     for (int y = y1; y <= y2; y++) {
       cx += ix;
-      if ((int)cx >= 0 && (int)cx < 300 && y >= 0 && y < 200) {
+      if ((int)cx >= 0 && (int)cx < fieldWidth && y >= 0 && y < fieldHeight) {
         if (st == 1)
-          field[(int)cx][y] = 99;
+          setWall((int)cx, y);
         else
           putpixel((int)cx, y, st);
       }
@@ -357,7 +356,7 @@ void logic_line(float zx1, float zy1, float zx2, float zy2, int st) {
 void bar(int x1, int y1, int x2, int y2) {
   for (int x = x1; x <= x2; x++) {
     for (int y = y1; y <= y2; y++) {
-      if (x >= 0 && x < 320 && y >= 0 && y < 200) {
+      if (x >= 0 && x < screenWidth && y >= 0 && y < screenHeight) {
         putpixel(x, y, 7);
       }
     }
@@ -367,60 +366,38 @@ void bar(int x1, int y1, int x2, int y2) {
 // --- Game Logic Functions ---
 
 void n(void) {
-  for (int x = 0; x < 320; x++) {
-    for (int y = 0; y < 200; y++)
-      field[x][y] = 0;
-  }
-  // Borders
-  for (int x = 0; x < 300; x++) {
-    field[x][0] = 99;
-    field[x][199] = 99;
-  }
-  for (int y = 0; y < 200; y++) {
-    field[0][y] = 99;
-    field[299][y] = 99;
-  }
+  clearWalls();
+  memset(field.cells, 0, (unsigned long)screenWidth * screenHeight);
+  addBorderWalls();
   game.rainmode = false;
+  sweepOdd = false;
+  wakeAll();
 }
 
 void clearLines() {
-  for (int x = 1; x < 299; x++) {
-    for (int y = 1; y < 199; y++) {
-      if (field[x][y] == 99)
-        field[x][y] = 0;
-    }
-  }
+  clearWalls();
+  addBorderWalls();
+  wakeAll();
 }
 
 void clearWater() {
-  for (int x = 0; x < 300; x++) {
-    for (int y = 0; y < 200; y++) {
-      if (field[x][y] < 99)
-        field[x][y] = 0;
-    }
-  }
-  // Re-add borders
-  for (int x = 0; x < 300; x++) {
-    field[x][0] = 99;
-    field[x][199] = 99;
-  }
-  for (int y = 0; y < 200; y++) {
-    field[0][y] = 99;
-    field[299][y] = 99;
-  }
+  memset(field.cells, 0, (unsigned long)screenWidth * screenHeight);
+  restoreWalls();
+  addBorderWalls();
   game.rainmode = false;
+  wakeAll();
 }
 
-void addWater() {
+void addWater(int mmx, int mmy) {
   int t = 4;
-  int mmx = mouse.x;
-  int mmy = mouse.y;
+  wakeRect(mmx - t, mmy - t * 2, mmx + t, mmy - 1);
   for (int qx = -t; qx <= t; qx++) {
     for (int qy = -t * 2; qy < 0; qy++) {
       if ((qy + mmy) >= 0) {
-        if (qx + mmx < 299 && qx + mmx > 0 && qy + mmy > 0 && qy + mmy < 200) {
-          if (field[qx + mmx][qy + mmy] < 99) {
-            field[qx + mmx][qy + mmy] = random_int(5);
+        if (qx + mmx < fieldWidth - 1 && qx + mmx > 0 && qy + mmy > 0 &&
+            qy + mmy < fieldHeight) {
+          if (field[qx + mmx][qy + mmy] < WALL_VALUE) {
+            field[qx + mmx][qy + mmy] = randomInt(5);
           }
         }
       }
@@ -428,106 +405,132 @@ void addWater() {
   }
 }
 
-void killWall() {
-  int sx = mouse.x - 2;
-  int sy = mouse.y - 2;
+void killWall(int x0, int y0) {
+  int sx = x0 - 2;
+  int sy = y0 - 2;
+  wakeRect(sx, sy, sx + 4, sy + 4);
   for (int x = sx; x < sx + 5; x++) {
     for (int y = sy; y < sy + 5; y++) {
-      if (x > 0 && x < 299 && y > 0 && y < 199 && field[x][y] == 99) {
-        field[x][y] = 0;
+      if (x > 0 && x < fieldWidth - 1 && y > 0 && y < fieldHeight - 1 &&
+          isWall(x, y)) {
+        removeWall(x, y);
       }
     }
   }
 }
 
-void killWater() {
-  int sx = mouse.x - 2;
-  int sy = mouse.y - 2;
+void killWater(int x0, int y0) {
+  int sx = x0 - 2;
+  int sy = y0 - 2;
+  wakeRect(sx, sy, sx + 4, sy + 4);
   for (int x = sx; x < sx + 5; x++) {
     for (int y = sy; y < sy + 5; y++) {
-      if (x > 0 && x < 300 && y > 0 && y < 199 && field[x][y] < 99) {
+      if (x > 0 && x < fieldWidth && y > 0 && y < fieldHeight - 1 &&
+          field[x][y] < WALL_VALUE) {
         field[x][y] = 0;
       }
     }
   }
 }
 
-void check() {
-  for (int a = 0; a < 10; a++) {
-    TButton &btn = buttons[a];
+/// Index of the button under each sidebar row, or -1; built by drawUI()
+static int8_t button_at_row[MIN_FIELD_HEIGHT];
 
-    // This is a simplified port of check()
-    if (mouse.leftDown == 1 && mouse.oldLeftDown == 0) {
-      if (mouse.checkInside(btn.x1, btn.y1, btn.x2, btn.y2)) {
-        // Logic for tool switching
-        // Standard tools map directly to indices 1-5
-        if (a == (int)Tool::Pencil) {
-          buttons[(int)Tool::Pencil].isDown = 1;
-          buttons[(int)Tool::EraserWall].isDown = 0;
-          buttons[(int)Tool::EraserWater].isDown = 0;
-          game.eraser = EraserMode::None;
-        }
-        if (a == (int)Tool::EraserWall) {
-          buttons[(int)Tool::Pencil].isDown = 0;
-          buttons[(int)Tool::EraserWall].isDown = 1;
-          buttons[(int)Tool::EraserWater].isDown = 0;
-          game.eraser = EraserMode::Wall;
-        }
-        if (a == (int)Tool::EraserWater) {
-          buttons[(int)Tool::Pencil].isDown = 0;
-          buttons[(int)Tool::EraserWall].isDown = 0;
-          buttons[(int)Tool::EraserWater].isDown = 1;
-          game.eraser = EraserMode::Water;
-        }
-        if (a == (int)Tool::Line) {
-          buttons[(int)Tool::Line].isDown = 1;
-          buttons[(int)Tool::Free].isDown = 0;
-          game.drawmode = 1;
-        }
-        if (a == (int)Tool::Free) {
-          buttons[(int)Tool::Line].isDown = 0;
-          buttons[(int)Tool::Free].isDown = 1;
-          game.drawmode = 2;
-        }
-      }
-    }
+/// Index of the button under pixel (x, y), or -1
+static int buttonAt(int x, int y) {
+  if (x < fieldWidth + 1 || x > screenWidth - 2 || y < 0 ||
+      y >= MIN_FIELD_HEIGHT)
+    return -1;
+  return button_at_row[y];
+}
 
-    // Toggle checking
-    if (mouse.checkInside(btn.x1, btn.y1, btn.x2, btn.y2)) {
-      if (mouse.leftDown == 0 && mouse.oldLeftDown == 1 && btn.isToggler == 1) {
-        if (btn.tag == (int)Action::Reset)
-          n(); // Reset
-        if (btn.tag == (int)Action::Pause)
-          game.paused = !game.paused;
-        if (btn.tag == (int)Action::ClearLines)
-          clearLines();
-        if (btn.tag == (int)Action::ClearWater)
-          clearWater();
-        if (btn.tag == (int)Action::Rain)
-          game.rainmode = !game.rainmode;
-
-        btn.isDown = 0; // Flash effect
-      }
+/// Show the tool and draw mode buttons pressed to match game.eraser and
+/// game.drawmode, e.g. after a snapshot was loaded
+void syncToolButtons() {
+  buttons[(int)Tool::Pencil].isDown = game.eraser == EraserMode::None;
+  buttons[(int)Tool::EraserWall].isDown = game.eraser == EraserMode::Wall;
+  buttons[(int)Tool::EraserWater].isDown = game.eraser == EraserMode::Water;
+  buttons[(int)Tool::Line].isDown = game.drawmode == 1;
+  buttons[(int)Tool::Free].isDown = game.drawmode == 2;
+  for (auto &btn : buttons)
+    btn.refresh();
+}
+
+/// Sidebar buttons: tool switches on press, actions on release
+void check(const TMouse &mouse) {
+  int a = buttonAt(mouse.x, mouse.y);
+
+  // This is a simplified port of check()
+  if (a >= 0 && mouse.leftDown == 1 && mouse.oldLeftDown == 0) {
+    // Logic for tool switching
+    // Standard tools map directly to indices 1-5
+    if (a == (int)Tool::Pencil) {
+      buttons[(int)Tool::Pencil].isDown = 1;
+      buttons[(int)Tool::EraserWall].isDown = 0;
+      buttons[(int)Tool::EraserWater].isDown = 0;
+      game.eraser = EraserMode::None;
+    }
+    if (a == (int)Tool::EraserWall) {
+      buttons[(int)Tool::Pencil].isDown = 0;
+      buttons[(int)Tool::EraserWall].isDown = 1;
+      buttons[(int)Tool::EraserWater].isDown = 0;
+      game.eraser = EraserMode::Wall;
+    }
+    if (a == (int)Tool::EraserWater) {
+      buttons[(int)Tool::Pencil].isDown = 0;
+      buttons[(int)Tool::EraserWall].isDown = 0;
+      buttons[(int)Tool::EraserWater].isDown = 1;
+      game.eraser = EraserMode::Water;
+    }
+    if (a == (int)Tool::Line) {
+      buttons[(int)Tool::Line].isDown = 1;
+      buttons[(int)Tool::Free].isDown = 0;
+      game.drawmode = 1;
+    }
+    if (a == (int)Tool::Free) {
+      buttons[(int)Tool::Line].isDown = 0;
+      buttons[(int)Tool::Free].isDown = 1;
+      game.drawmode = 2;
     }
-    btn.paint();
   }
+
+  // Toggle checking
+  if (a >= 0 && mouse.leftDown == 0 && mouse.oldLeftDown == 1 &&
+      buttons[a].isToggler == 1) {
+    TButton &btn = buttons[a];
+    if (btn.tag == (int)Action::Reset)
+      n(); // Reset
+    if (btn.tag == (int)Action::Pause)
+      game.paused = !game.paused;
+    if (btn.tag == (int)Action::ClearLines)
+      clearLines();
+    if (btn.tag == (int)Action::ClearWater)
+      clearWater();
+    if (btn.tag == (int)Action::Rain)
+      game.rainmode = !game.rainmode;
+
+    btn.isDown = 0; // Flash effect
+  }
+
+  // Only buttons whose state changed are redrawn
+  for (auto &btn : buttons)
+    btn.refresh();
 }
 
+/// Buttons and icons have been set up (once per world)
+static bool ui_built = false;
+
 void drawUI() {
   // Re-create buttons if first run
-  static int initialized = 0;
-  if (!initialized) {
-    bar(300, 0, 319, 199);
-
+  if (!ui_built) {
     // No dynamic allocation needed!
     // Just setting values.
 
     // --- Button Definitions ---
-    // Helper lambda for setup?
+    // Helper lambda for setup? (x is set below, as the sidebar moves with the
+    // field width)
     auto setupBtn = [&](int i, int y1, int y2, int tag) {
-      buttons[i].x1 = 301;
       buttons[i].y1 = y1;
-      buttons[i].x2 = 318;
       buttons[i].y2 = y2;
       buttons[i].tag = tag;
     };
@@ -569,7 +572,7 @@ void drawUI() {
     fillIcon(0);
     for (int y = 0; y < 16; y++)
       for (int x = 0; x < 16; x++)
-        if (random_int(5) == 1)
+        if (randomInt(5) == 1)
           icon[x][y] = 1;
     buttons[0].setBlitMap(&icon);
 
@@ -617,14 +620,14 @@ void drawUI() {
     fillIcon(16); // Transparent background
     for (int y = 0; y < 7; y++)
       for (int x = 0; x < 16; x++)
-        icon[x][y] = (random_int(2) ? 15 : 0);
+        icon[x][y] = (randomInt(2) ? 15 : 0);
     buttons[8].setBlitMap(&icon);
 
     // 9: Clear Water (Small Noise) - MUST be < 8px tall
     fillIcon(16); // Transparent background
     for (int y = 0; y < 7; y++)
       for (int x = 0; x < 16; x++)
-        icon[x][y] = (random_int(2) ? 1 : 0);
+        icon[x][y] = (randomInt(2) ? 1 : 0);
     buttons[9].setBlitMap(&icon);
 
     // 7: Reset (Cross)
@@ -635,74 +638,217 @@ void drawUI() {
     }
     buttons[7].setBlitMap(&icon);
 
-    initialized = 1;
+    ui_built = true;
+  }
+
+  for (auto &btn : buttons) {
+    btn.x1 = fieldWidth + 1;
+    btn.x2 = screenWidth - 2;
+    btn.buildSprites();
   }
 
+  // Hit-test table (the buttons span the sidebar and do not overlap)
+  memset(button_at_row, -1, sizeof(button_at_row));
+  for (int i = 0; i < 10; i++)
+    for (int y = buttons[i].y1; y <= buttons[i].y2; y++)
+      if (y >= 0 && y < MIN_FIELD_HEIGHT)
+        button_at_row[y] = i;
+
   // Repaint all
-  bar(300, 0, 319, 199);
+  bar(fieldWidth, 0, screenWidth - 1, screenHeight - 1);
   for (auto &btn : buttons)
     btn.paint();
 }
 
+/**
+ * @brief Set the layout for a field of the given size and allocate the
+ * buffers that depend on it
+ *
+ * Sizes of 0 or less select the default field; others are clamped to the
+ * supported range. Returns false if the buffers do not fit in memory.
+ */
+static bool allocateScreen(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    width = DEFAULT_FIELD_WIDTH;
+    height = DEFAULT_FIELD_HEIGHT;
+  }
+  fieldWidth = width < MIN_FIELD_WIDTH    ? MIN_FIELD_WIDTH
+               : width > MAX_FIELD_SIZE   ? MAX_FIELD_SIZE
+                                          : width;
+  fieldHeight = height < MIN_FIELD_HEIGHT ? MIN_FIELD_HEIGHT
+                : height > MAX_FIELD_SIZE ? MAX_FIELD_SIZE
+                                          : height;
+  screenWidth = fieldWidth + SIDEBAR_WIDTH;
+  screenHeight = fieldHeight;
+
+  arenaReset();
+  resetReplay();
+  resetHistory();
+  video_buffer = arenaAlloc((unsigned long)screenWidth * screenHeight * 4);
+  return video_buffer && arenaGrid(&field, screenWidth, screenHeight) &&
+         allocateWalls() && initSim() && allocateSnapshot();
+}
+
+static int clampInt(int v, int lo, int hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
 extern "C" {
 
-void init() {
+/// Size the field (0, 0 for the default 300x200) and reset the game. Returns
+/// 0 if the requested size did not fit in memory and the default was used.
+int init(int width, int height) {
   console_log(1001);
+  buildPalette();
+  int ok = allocateScreen(width, height);
+  if (!ok)
+    allocateScreen(0, 0);
   n();
   drawUI();
   console_log(1002);
+  return ok;
 }
 
+int get_screen_width() { return screenWidth; }
+
+int get_screen_height() { return screenHeight; }
+
 uint8_t *get_video_buffer() { return video_buffer; }
 
+/// Queue a move of pointer 0 to (x, y) with the buttons unchanged. Hosts that send many
+/// events should write them into get_input_queue() directly instead.
 void set_mouse_pos(int x, int y) {
-  input_mouse_x = x;
-  input_mouse_y = y;
+  queued_x = x;
+  queued_y = y;
+  pushInputEvent(get_time_ms(), 0, x, y, queued_btn);
 }
 
-void set_mouse_button(int btn) { input_mouse_btn = btn; }
+/// Queue a button change (0 = none, 1 = left, 2 = right) at the last position
+void set_mouse_button(int btn) {
+  queued_btn = btn;
+  pushInputEvent(get_time_ms(), 0, queued_x, queued_y, btn);
+}
 
-void update() {
-  // 1. Mouse Update
-  mouse.update();
-  check();
+/// The pointer event ring the host appends to (layout in input.h)
+InputQueue *get_input_queue() { return &inputQueue; }
 
-  // 2. Logic Update
-  if (game.rainmode && !game.paused) {
-    for (int u = 1; u < 299; u++) {
-      if (random_int(RAIN_PROBABILITY) == 1)
-        field[u][1] = WATER_SPAWN_AMOUNT;
-    }
+int get_input_queue_size() { return INPUT_QUEUE_SIZE; }
+
+/// Number of pointer slots events may address (0 .. n-1)
+int get_max_pointers() { return MAX_POINTERS; }
+
+/// Select the flow kernel: 0 = in-place reference, 1 = Jacobi
+void set_sim_mode(int mode) {
+  simMode = mode == (int)SimMode::Jacobi ? SimMode::Jacobi : SimMode::InPlace;
+  recordSetting(Setting::SimMode, (int)simMode);
+}
+
+int get_sim_mode() { return (int)simMode; }
+
+/**
+ * @brief Set a tunable parameter (see Param), clamped to its valid range
+ *
+ * densityFlow is limited to MAX_DENSITY_FLOW so four Jacobi inflows still
+ * fit in a byte, and maxWater stays below WALL_VALUE.
+ */
+void set_param(int param, int value) {
+  switch ((Param)param) {
+  case Param::DensityFlow:
+    simParams.densityFlow = clampInt(value, 1, MAX_DENSITY_FLOW);
+    break;
+  case Param::MaxWater:
+    simParams.maxWater = clampInt(value, 1, WALL_VALUE - 2);
+    break;
+  case Param::RainProbability:
+    simParams.rainProbability = clampInt(value, 1, 1 << 30);
+    break;
+  case Param::WaterSpawnAmount:
+    simParams.waterSpawnAmount = clampInt(value, 1, WALL_VALUE - 2);
+    break;
+  case Param::SweepOrder:
+    simParams.sweepOrder = clampInt(value, 0, (int)SweepOrder::Serpentine);
+    break;
+  default:
+    return;
   }
+  wakeAll();
+  recordSetting((Setting)((int)Setting::Param + param), value);
+}
+
+/// Run up to k steps per block in multi-step Jacobi runs (1 turns temporal
+/// tiling off), clamped to [1, MAX_TEMPORAL_STEPS]
+void set_temporal_steps(int k) {
+  temporalSteps = clampInt(k, 1, MAX_TEMPORAL_STEPS);
+}
 
-  if (mouse.rightDown == 1) {
-    if (game.eraser == EraserMode::None)
-      addWater();
-    if (game.eraser == EraserMode::Wall)
-      killWall();
-    if (game.eraser == EraserMode::Water)
-      killWater();
+int get_temporal_steps() { return temporalSteps; }
+
+/// Current value of a tunable parameter, or -1 for an unknown one
+int get_param(int param) {
+  switch ((Param)param) {
+  case Param::DensityFlow:
+    return simParams.densityFlow;
+  case Param::MaxWater:
+    return simParams.maxWater;
+  case Param::RainProbability:
+    return simParams.rainProbability;
+  case Param::WaterSpawnAmount:
+    return simParams.waterSpawnAmount;
+  case Param::SweepOrder:
+    return simParams.sweepOrder;
+  default:
+    return -1;
   }
+}
 
-  // Left click erasing (User Request)
-  if (mouse.leftDown == 1) {
-    if (game.eraser == EraserMode::Wall)
-      killWall();
-    if (game.eraser == EraserMode::Water)
-      killWater();
+/// Enable (1) or disable (0) skipping of sleeping tiles
+void set_sleep_tiles(int enabled) {
+  sleepTiles = enabled != 0;
+  wakeAll();
+  recordSetting(Setting::SleepTiles, sleepTiles);
+}
+
+/// Split the Jacobi kernel over n threads (1 when built without threads)
+void set_thread_count(int n) { setThreadCount(n); }
+
+int get_thread_count() { return getThreadCount(); }
+
+#if defined(SLIME_THREADS) && defined(__wasm__)
+/// Entry point for Web Worker `id`, called once its stack pointer is set
+void worker_main(int id) { workerMain(id); }
+
+/// Initial __stack_pointer for Web Worker `id`
+uint8_t *worker_stack_top(int id) { return workerStackTop(id); }
+#endif
+
+} // extern "C"
+
+/// Apply one sample of a pointer: button edges, sidebar buttons and wall
+/// drawing
+static void handlePointer(Pointer &p, int x, int y, int buttons) {
+  TMouse &mouse = p.mouse;
+  InputState &input = p.input;
+  mouse.update(x, y, buttons);
+  check(mouse);
+
+  // The pointer keeps the tool it went down with
+  if ((mouse.leftDown && !mouse.oldLeftDown) ||
+      (mouse.rightDown && !mouse.oldRightDown)) {
+    input.eraser = game.eraser;
+    input.drawmode = game.drawmode;
   }
 
   // Drawing Logic (Only if not erasing)
-  if (game.eraser == EraserMode::None) {
-    if (game.drawmode == 1) { // Lines
+  if (input.eraser == EraserMode::None) {
+    if (input.drawmode == 1) { // Lines
       if ((mouse.leftDown == 1) && (mouse.oldLeftDown == 0) &&
-          mouse.x < FIELD_WIDTH) {
+          mouse.x < fieldWidth) {
         input.hasLeft = true;
         input.x1 = mouse.x;
         input.y1 = mouse.y;
       }
       if ((mouse.leftDown == 1) && (mouse.oldLeftDown == 1) && input.hasLeft &&
-          mouse.x < FIELD_WIDTH) {
+          mouse.x < fieldWidth) {
         // Preview logic would go here
       }
       if ((mouse.leftDown == 0) && (mouse.oldLeftDown == 1) && input.hasLeft) {
@@ -711,7 +857,7 @@ void update() {
       }
     } else { // Free draw
       if (mouse.leftDown == 1 && mouse.oldLeftDown == 0 &&
-          mouse.x < FIELD_WIDTH) {
+          mouse.x < fieldWidth) {
         input.mayDraw = true;
         input.hasLeft = true;
         input.x1 = mouse.x;
@@ -727,123 +873,274 @@ void update() {
         input.mayDraw = false;
     }
   }
+}
 
-  game.frames++;
+/**
+ * @brief Apply one frame's pointer events
+ *
+ * Every event is applied in order to its pointer, so a click that starts
+ * and ends between two frames still registers and a fast freehand stroke
+ * follows each sample rather than a straight line between frames. Pointers
+ * without events apply their last state once, as before.
+ */
+void applyInput(const InputEvent *events, int count) {
+  bool seen[MAX_POINTERS] = {};
+  for (int i = 0; i < count; i++) {
+    const InputEvent &event = events[i];
+    int slot = event.pointer;
+    if (slot < 0 || slot >= MAX_POINTERS)
+      continue;
+    handlePointer(pointers[slot], event.x, event.y, event.buttons);
+    seen[slot] = true;
+  }
+  for (int slot = 0; slot < MAX_POINTERS; slot++) {
+    if (seen[slot])
+      continue;
+    TMouse &m = pointers[slot].mouse;
+    handlePointer(pointers[slot], m.x, m.y,
+                  m.leftDown ? 1 : (m.rightDown ? 2 : 0));
+  }
+}
 
-  // Simulation Step
-  if (!game.paused) {
-    for (int x = 1; x < 319; x++) {
-      for (int y = 198; y > 0; y--) {
-        if (field[x][y + 1] == 100)
-          field[x][y] = 0; // Drain?
-
-        if ((field[x][y] > 0) && (field[x][y] < 99)) {
-          field[x][y]--; // Decay/Flow
-
-          int u = field[x][y - 1];
-          int d = field[x][y + 1];
-          int l = field[x - 1][y];
-          int r = field[x + 1][y];
-
-          int q = d;
-          int b = 2; // Default down
-
-          // Water logic: find lowest neighbor
-          if (u < q) {
-            q = u;
-            b = 1;
-          } // Up? (Pressure?)
-          if (l < q) {
-            q = l;
-            b = 3;
-          }
-          if (r < q) {
-            q = r;
-            b = 4;
-          }
+extern "C" {
+
+/// Events taken from the queue for one frame
+static InputEvent frame_events[INPUT_QUEUE_SIZE];
+
+/**
+ * @brief Per-frame input: drain the pointer event queue
+ *
+ * Runs once per presented frame, however many steps the frame advances.
+ * The frame's events are logged while recording (see replay.h).
+ */
+static void processInput() {
+  int count = 0;
+  while (count < INPUT_QUEUE_SIZE && popInputEvent(&frame_events[count]))
+    count++;
+  applyInput(frame_events, count);
+  recordInput(frame_events, count);
+}
 
-          // Move water
-          if (b == 1 && field[x][y - 1] < 97)
-            field[x][y - 1]++;
-          if (b == 2 && field[x][y + 1] < 97)
-            field[x][y + 1]++;
-          if (b == 3 && field[x - 1][y] < 97)
-            field[x - 1][y]++;
-          if (b == 4 && field[x + 1][y] < 97)
-            field[x + 1][y]++;
+/**
+ * @brief One fixed step: rain, held brushes and the water simulation
+ *
+ * Brushes act per step so that water is added and erased at the same rate
+ * whatever the display refresh rate.
+ */
+static void tick() {
+  if (game.rainmode && !game.paused) {
+    // Each column gets a drop with probability 1 / rainProbability; the
+    // random words are generated a batch at a time
+    const uint32_t threshold = 0xFFFFFFFFu / simParams.rainProbability;
+    uint32_t r[64];
+    for (int u0 = 1; u0 < fieldWidth - 1; u0 += 64) {
+      int count = fieldWidth - 1 - u0 < 64 ? fieldWidth - 1 - u0 : 64;
+      randomFill(r, count);
+      for (int i = 0; i < count; i++) {
+        if (r[i] < threshold) {
+          // A drop replaces whatever is there, walls included
+          if (isWall(u0 + i, 1))
+            removeWall(u0 + i, 1);
+          field[u0 + i][1] = simParams.waterSpawnAmount;
+          wakeRect(u0 + i, 1, u0 + i, 1);
         }
       }
     }
+  }
 
-    // Pass 2: Mass Conserving Flow (Backwards)
-    // "DENSITY_FLOW" determines the rate of flow in this pass (originally k=2)
-    for (int x = 318; x > 0; x--) {
-      for (int y = 198; y >= 1; y--) {
-        if ((field[x][y] > 0) &&
-            (field[x][y] < 99)) { // Match original condition
-          int u = field[x][y - 1];
-          int d = field[x][y + 1];
-          int l = field[x - 1][y];
-          int r = field[x + 1][y];
-
-          int q = d;
-          int b = 2; // Default (down)
-
-          if (l < q) {
-            q = l;
-            b = 3;
-          }
-          if (r < q) {
-            q = r;
-            b = 4;
-          }
-          if (u < q) {
-            q = u;
-            b = 1;
-          }
+  for (const Pointer &p : pointers) {
+    const TMouse &m = p.mouse;
+    if (m.rightDown == 1) {
+      if (p.input.eraser == EraserMode::None)
+        addWater(m.x, m.y);
+      if (p.input.eraser == EraserMode::Wall)
+        killWall(m.x, m.y);
+      if (p.input.eraser == EraserMode::Water)
+        killWater(m.x, m.y);
+    }
 
-          // Move water - use available amount to prevent sticking
-          int flowAmt =
-              (field[x][y] >= DENSITY_FLOW) ? DENSITY_FLOW : field[x][y];
-          if (flowAmt > 0) {
-            if (b == 1 && field[x][y - 1] < 97) {
-              field[x][y - 1] += flowAmt;
-              field[x][y] -= flowAmt;
-            } else if (b == 2 && field[x][y + 1] < 97) {
-              field[x][y + 1] += flowAmt;
-              field[x][y] -= flowAmt;
-            } else if (b == 3 && field[x - 1][y] < 97) {
-              field[x - 1][y] += flowAmt;
-              field[x][y] -= flowAmt;
-            } else if (b == 4 && field[x + 1][y] < 97) {
-              field[x + 1][y] += flowAmt;
-              field[x][y] -= flowAmt;
-            }
-          }
-        }
-      }
+    // Left click erasing (User Request)
+    if (m.leftDown == 1) {
+      if (p.input.eraser == EraserMode::Wall)
+        killWall(m.x, m.y);
+      if (p.input.eraser == EraserMode::Water)
+        killWater(m.x, m.y);
     }
   }
+
+  game.frames++;
+
+  // Simulation Step
+  if (!game.paused)
+    simulate();
 }
 
-void render() {
-  // Redraw field to screen
-  for (int x = 0; x < 300; x++) {
-    for (int y = 0; y < 200; y++) {
-      if (field[x][y] == 99) {
-        putpixel(x, y, WHITE); // White wall
-      } else if (field[x][y] != 0) {
-        // Water color calculation
-        putpixel(x, y, (field[x][y] + 1) / 2 + 103);
-      } else {
-        putpixel(x, y, 0);
-      }
+/// Process input and run exactly one step
+void update() {
+  processInput();
+  tick();
+}
+
+/// True if no pointer holds a button, so steps do nothing but simulate
+static bool brushesIdle() {
+  for (const Pointer &p : pointers)
+    if (p.mouse.leftDown || p.mouse.rightDown)
+      return false;
+  return true;
+}
+
+/**
+ * @brief Run n steps in one call without processing input or rendering (for
+ * fast-forwarding); returns the number of steps run
+ *
+ * Without rain or held brushes the steps are pure simulation and are handed
+ * to the kernel together, so that it can tile them in time.
+ */
+int step_many(int n) {
+  if (n > 1 && !game.paused && !game.rainmode && brushesIdle()) {
+    simulateSteps(n);
+    game.frames += n;
+    return n;
+  }
+  int steps = 0;
+  for (; steps < n; steps++)
+    tick();
+  return steps;
+}
+
+/**
+ * @brief True if stepping would leave the field as it is, so the host can
+ * stop stepping and presenting until new input arrives
+ *
+ * That is the case when no brush is held and either the simulation is
+ * paused or it has no awake tile (the water has come to rest and nothing
+ * was edited since) and no rain. With sleeping tiles off every tile stays
+ * awake, so the field never counts as idle.
+ */
+int is_idle() {
+  if (!brushesIdle())
+    return 0;
+  return game.paused || (!game.rainmode && countAwakeTiles() == 0);
+}
+
+/// Number of tiles whose cells changed in the last step
+int get_changed_tiles() { return countChangedTiles(); }
+
+/**
+ * @brief Run up to `steps` steps without processing input or rendering, for
+ * catching up or previewing; returns the number of steps done
+ *
+ * Stops once time_budget_ms of wall time has been spent (no limit if it is 0
+ * or less), so the host can spread a long catch-up over several frames. The
+ * clock is read every FAST_FORWARD_CHUNK steps, which go to step_many()
+ * together, so the budget can be overrun by up to one chunk. Once the
+ * running field is idle the remaining steps could not change it and count
+ * as done without being run (see skipSteps()). Paused steps are run, which
+ * costs next to nothing.
+ */
+int fast_forward(int steps, double time_budget_ms) {
+  double start = get_time_ms();
+  int done = 0;
+  while (done < steps) {
+    if (!game.paused && is_idle()) {
+      skipSteps(steps - done);
+      game.frames += steps - done;
+      return steps;
     }
+    int chunk = steps - done < FAST_FORWARD_CHUNK ? steps - done
+                                                  : FAST_FORWARD_CHUNK;
+    done += step_many(chunk);
+    if (time_budget_ms > 0 && get_time_ms() - start >= time_budget_ms)
+      break;
+  }
+  return done;
+}
+
+/**
+ * @brief Fixed-timestep frame update
+ *
+ * Processes input, then runs as many steps as elapsed_ms of wall time
+ * covers at the current speed (STEP_MS of simulated time each), carrying the
+ * remainder over to the next frame. A backlog of more than
+ * MAX_STEPS_PER_FRAME steps, e.g. after the tab was hidden, is dropped.
+ * Returns the number of steps run.
+ */
+int advance(double elapsed_ms) {
+  processInput();
+  if (elapsed_ms > 0)
+    game.stepDebt += elapsed_ms * game.speed;
+  int steps = (int)(game.stepDebt / STEP_MS);
+  if (steps > MAX_STEPS_PER_FRAME) {
+    steps = MAX_STEPS_PER_FRAME;
+    game.stepDebt = 0;
+  } else {
+    game.stepDebt -= steps * STEP_MS;
+  }
+  return step_many(steps);
+}
+
+/// Restart the random sequence (rain, water brush) from seed, so that a run
+/// with the same seed and input is reproduced exactly
+void seed_random(uint32_t seed) {
+  seedRandom(seed);
+  recordSetting(Setting::Seed, (int)seed);
+}
+
+uint32_t get_random_seed() { return randomSeed(); }
+
+/// Set the simulation speed multiplier used by advance(), clamped to
+/// [MIN_SPEED, MAX_SPEED]
+void set_speed(double speed) {
+  game.speed = speed < MIN_SPEED   ? MIN_SPEED
+               : speed > MAX_SPEED ? MAX_SPEED
+                                   : speed;
+}
+
+double get_speed() { return game.speed; }
+
+/// Screen rectangles {x, y, width, height} repainted by the last render()
+static int dirty_rects[MAX_DIRTY_RECTS * 4];
+static int dirty_count = 0;
+
+/// Repaint the field pixels inside the rectangle (x, y, w, h)
+static void paintField(int x, int y, int w, int h) {
+  int x2 = x + w < fieldWidth ? x + w : fieldWidth;
+  int y2 = y + h < fieldHeight ? y + h : fieldHeight;
+  // One table lookup and one 32-bit store per pixel. Local copies keep the
+  // loop free of reloads through aliasing stores.
+  const Grid cells = field;
+  const int stride = screenWidth;
+  uint32_t *row = (uint32_t *)video_buffer + y * stride;
+  for (; y < y2; y++, row += stride) {
+    const uint8_t *cell = cells[0] + y;
+    for (int px = x; px < x2; px++)
+      row[px] = cellColor[cell[px * cells.stride]];
+  }
+}
+
+/**
+ * @brief Bring video_buffer up to date
+ *
+ * Only dirty tiles are repainted. The tiles under the mouse cursor are
+ * marked first so it is drawn this frame; drawing it marks them again, so
+ * the next frame repaints them and erases it if it has moved. The repainted
+ * rectangles are then available from get_dirty_rects() for the host to
+ * upload.
+ */
+void render() {
+  bool cursor = mouse.x < fieldWidth - 1;
+  int mx = mouse.x, my = mouse.y;
+  if (cursor)
+    markDirtyRect(mx - 1, my - 1, mx + 1, my + 1);
+
+  dirty_count = takeDirtyRects(dirty_rects);
+  for (int i = 0; i < dirty_count; i++) {
+    const int *r = &dirty_rects[i * 4];
+    paintField(r[0], r[1], r[2], r[3]);
   }
 
   // Redraw mouse
-  if (mouse.x < 299) {
-    int mx = mouse.x, my = mouse.y;
+  if (cursor) {
     putpixel(mx, my, 14);
     putpixel(mx + 1, my, 14);
     putpixel(mx, my + 1, 14);
@@ -852,4 +1149,53 @@ void render() {
   }
 }
 
+/// Number of rectangles repainted by the last render()
+int get_dirty_rect_count() { return dirty_count; }
+
+/// The rectangles repainted by the last render(), as {x, y, width, height}
+/// int32 quadruples
+int *get_dirty_rects() { return dirty_rects; }
+
 } // extern "C"
+
+void saveEngineState(EngineState *state) {
+  state->fieldWidth = fieldWidth;
+  state->fieldHeight = fieldHeight;
+  state->screenWidth = screenWidth;
+  state->screenHeight = screenHeight;
+  state->video_buffer = video_buffer;
+  state->field = field;
+  state->game = game;
+  for (int i = 0; i < MAX_POINTERS; i++)
+    state->pointers[i] = pointers[i];
+  state->queued_x = queued_x;
+  state->queued_y = queued_y;
+  state->queued_btn = queued_btn;
+  for (int i = 0; i < 10; i++)
+    state->buttons[i] = buttons[i];
+  state->uiBuilt = ui_built;
+  memcpy(state->buttonAtRow, button_at_row, sizeof(button_at_row));
+  memcpy(state->dirtyRects, dirty_rects, sizeof(dirty_rects));
+  state->dirtyCount = dirty_count;
+}
+
+void loadEngineState(const EngineState &state) {
+  fieldWidth = state.fieldWidth;
+  fieldHeight = state.fieldHeight;
+  screenWidth = state.screenWidth;
+  screenHeight = state.screenHeight;
+  video_buffer = state.video_buffer;
+  field = state.field;
+  game = state.game;
+  for (int i = 0; i < MAX_POINTERS; i++)
+    pointers[i] = state.pointers[i];
+  queued_x = state.queued_x;
+  queued_y = state.queued_y;
+  queued_btn = state.queued_btn;
+  for (int i = 0; i < 10; i++)
+    buttons[i] = state.buttons[i];
+  ui_built = state.uiBuilt;
+  memcpy(button_at_row, state.buttonAtRow, sizeof(button_at_row));
+  memcpy(dirty_rects, state.dirtyRects, sizeof(dirty_rects));
+  dirty_count = state.dirtyCount;
+}
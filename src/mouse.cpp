@@ -2,17 +2,12 @@
  * @file mouse.cpp
  * @brief Mouse input implementation
  *
- * Reads mouse state from JavaScript-provided global variables
+ * Tracks one pointer's position and buttons, fed from the input queue,
  * and manages cursor visibility.
  */
 
 #include "mouse.h"
 
-// External input state variables (set by JavaScript runtime)
-extern int input_mouse_x;   ///< Current mouse X position
-extern int input_mouse_y;   ///< Current mouse Y position
-extern int input_mouse_btn; ///< Button state: 0=none, 1=left, 2=right
-
 /**
  * @brief Initialize mouse at screen center
  */
@@ -75,21 +70,20 @@ void TMouse::setMousePosition(int newX, int newY) {
 }
 
 /**
- * @brief Update mouse state from JavaScript input
+ * @brief Update mouse state from one input sample
  *
- * Called once per frame to sync with browser input.
- * Preserves previous button states for click detection.
+ * Called for every queued event of this pointer, and once per frame for
+ * pointers without events. Preserves previous button states for click
+ * detection.
  *
  * Button state encoding from JS:
  * - 0: No buttons pressed
  * - 1: Left button pressed
  * - 2: Right button pressed
  */
-void TMouse::update() {
-  // Read from global input state
-  x = input_mouse_x;
-  y = input_mouse_y;
-  int bState = input_mouse_btn;
+void TMouse::update(int newX, int newY, int bState) {
+  x = newX;
+  y = newY;
 
   // Preserve previous state for edge detection
   oldLeftDown = leftDown;
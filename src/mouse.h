@@ -2,8 +2,8 @@
  * @file mouse.h
  * @brief Mouse input handling
  *
- * Provides mouse state tracking including position and button states.
- * Reads from global input variables set by JavaScript.
+ * Provides mouse state tracking including position and button states,
+ * one instance per pointer.
  */
 
 #ifndef MOUSE_H
@@ -16,8 +16,8 @@
  * @brief Manages mouse cursor state and input
  *
  * Tracks current and previous button states to detect clicks.
- * The cursor position and button state are updated each frame
- * from JavaScript-provided global variables.
+ * The cursor position and button state are updated from the pointer
+ * events JavaScript queues (see input.h).
  */
 class TMouse {
 public:
@@ -25,12 +25,12 @@ public:
   ~TMouse();
 
   /**
-   * @brief Update mouse state from global input variables
+   * @brief Update mouse state from one input sample
    *
-   * Should be called once per frame. Updates position and button
-   * states, preserving previous state for edge detection.
+   * Updates position and button states (0 = none, 1 = left,
+   * 2 = right), preserving previous state for edge detection.
    */
-  void update();
+  void update(int newX, int newY, int buttons);
 
   /// Show the mouse cursor
   void show();
@@ -12,49 +12,73 @@
 
 #include <stdint.h>
 
+#if defined(__wasm__)
 #define NULL 0
+#else
+// Native builds (benchmarks, profiling) link against the host libc instead of
+// the replacements below. See platform_native.cpp for the JS import shim.
+#include <math.h>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#endif
 
 // =============================================================================
 // JS Imports - Functions provided by the JavaScript runtime
 // =============================================================================
 extern "C" {
-/// Generate a random integer in range [0, max)
-int random_int(int max);
-
 /// Log an integer value to browser console (for debugging)
 void console_log(int val);
 
 /// Get current time in milliseconds
 double get_time_ms();
 
+#if defined(__wasm__)
 /// Standard math functions (provided by JS Math object)
 double sin(double x);
 double cos(double x);
 double fabs(double x);
+#endif
 }
 
 // =============================================================================
 // Simulation Constants
 // =============================================================================
 
-// Screen dimensions
-constexpr int SCREEN_WIDTH = 320;  ///< Total screen width in pixels
-constexpr int SCREEN_HEIGHT = 200; ///< Total screen height in pixels
-constexpr int FIELD_WIDTH = 300;   ///< Playable simulation area width
-constexpr int FIELD_HEIGHT = 200;  ///< Playable simulation area height
-constexpr int SIDEBAR_X = 300;     ///< X position where sidebar starts
+// Screen layout. The field size is chosen at runtime by init(); the sidebar
+// is a fixed-width strip to the right of the field.
+constexpr int DEFAULT_FIELD_WIDTH = 300;  ///< Field width used by init(0, 0)
+constexpr int DEFAULT_FIELD_HEIGHT = 200; ///< Field height used by init(0, 0)
+constexpr int MIN_FIELD_WIDTH = 16;       ///< Smallest accepted field width
+constexpr int MIN_FIELD_HEIGHT = 200;     ///< The sidebar buttons need 200 rows
+constexpr int MAX_FIELD_SIZE = 8192;      ///< Largest accepted width or height
+constexpr int SIDEBAR_WIDTH = 20;         ///< Sidebar width in pixels
+
+// Current layout, set by init() (defined in main.cpp)
+extern int fieldWidth;   ///< Playable simulation area width
+extern int fieldHeight;  ///< Playable simulation area height
+extern int screenWidth;  ///< Total screen width: fieldWidth + SIDEBAR_WIDTH
+extern int screenHeight; ///< Total screen height, equal to fieldHeight
 
 // Cell value constants
 constexpr int WALL_VALUE = 99;   ///< Field value representing a wall
-constexpr int MAX_WATER = 97;    ///< Maximum water density per cell
+constexpr int MAX_WATER = 97;    ///< Default maximum water density per cell
 constexpr int DRAIN_VALUE = 100; ///< Field value representing a drain
 
-// Simulation parameters
-constexpr int RAIN_PROBABILITY = 100; ///< 1 in N chance per column per frame
+// Simulation parameters (the tunable ones are defaults, see SimParams)
+constexpr int RAIN_PROBABILITY = 100; ///< 1 in N chance per column per step
 constexpr int WATER_SPAWN_AMOUNT = 5; ///< Initial water value when spawned
 constexpr int ERASER_SIZE = 5;        ///< Eraser brush size in pixels
 constexpr int WATER_ADD_RADIUS = 4;   ///< Water brush radius
 constexpr int DENSITY_FLOW = 2;       ///< Water mass transferred per flow step
+constexpr int MAX_DENSITY_FLOW = 32;  ///< Keeps Jacobi inflow sums in a byte
+
+// Fixed timestep (see advance() in main.cpp)
+constexpr double STEP_MS = 1000.0 / 60.0; ///< Simulated time per step at 1x
+constexpr double MIN_SPEED = 0.125;       ///< Slowest speed multiplier
+constexpr double MAX_SPEED = 16.0;        ///< Fastest speed multiplier
+constexpr int MAX_STEPS_PER_FRAME = 64;   ///< Backlog beyond this is dropped
+constexpr int FAST_FORWARD_CHUNK = 8;     ///< fast_forward() steps per clock read
 
 // VGA palette color indices
 constexpr int DARKGRAY = 8;
@@ -66,28 +90,83 @@ constexpr int WHITE = 15;
 
 /**
  * @brief Check if coordinates are within the simulation field
- * @param x X coordinate (0-299)
- * @param y Y coordinate (0-199)
+ * @param x X coordinate (0 to fieldWidth - 1)
+ * @param y Y coordinate (0 to fieldHeight - 1)
  * @return true if within bounds
  */
 inline bool inField(int x, int y) {
-  return x >= 0 && x < FIELD_WIDTH && y >= 0 && y < FIELD_HEIGHT;
+  return x >= 0 && x < fieldWidth && y >= 0 && y < fieldHeight;
 }
 
 /**
  * @brief Check if coordinates are within the screen
- * @param x X coordinate (0-319)
- * @param y Y coordinate (0-199)
+ * @param x X coordinate (0 to screenWidth - 1)
+ * @param y Y coordinate (0 to screenHeight - 1)
  * @return true if within bounds
  */
 inline bool inScreen(int x, int y) {
-  return x >= 0 && x < SCREEN_WIDTH && y >= 0 && y < SCREEN_HEIGHT;
+  return x >= 0 && x < screenWidth && y >= 0 && y < screenHeight;
 }
 
+// =============================================================================
+// Runtime Buffers (arena.cpp)
+// =============================================================================
+
+/**
+ * @brief Column-major byte grid sized at runtime
+ *
+ * grid[x] points at column x and grid[x][y] is a cell, so a Grid is indexed
+ * exactly like a fixed uint8_t[W][H] array. Columns are contiguous in y.
+ */
+struct Grid {
+  uint8_t *cells = nullptr;
+  int stride = 0; ///< Cells per column
+  uint8_t *operator[](int x) const { return cells + x * stride; }
+};
+
+/// Allocate n zeroed, 16-byte aligned bytes; nullptr if out of memory
+uint8_t *arenaAlloc(unsigned long n);
+
+/// Grow p, the last allocation and `size` bytes long, to n bytes (the new
+/// bytes zeroed); nullptr if p is not the last allocation or out of memory,
+/// in which case p stays as it was. The result may have moved natively.
+uint8_t *arenaGrow(uint8_t *p, unsigned long size, unsigned long n);
+
+/// Allocate a zeroed width x height grid; false if out of memory
+bool arenaGrid(Grid *grid, int width, int height);
+
+/// Release everything allocated so far, before sizing the buffers again
+void arenaReset();
+
+/// One world's allocations (see context.cpp). In WASM a world owns a region
+/// of linear memory; natively it owns a list of calloc blocks.
+struct ArenaState {
+#if defined(__wasm__)
+  unsigned long base = 0; ///< Start of the region
+  unsigned long top = 0;  ///< Next free byte
+  unsigned long end = 0;  ///< End of the memory reserved for the region
+#else
+  void *blocks[32] = {};
+  int count = 0;
+#endif
+};
+
+/// Copy the live arena out (to switch worlds) and back in
+void saveArenaState(ArenaState *state);
+void loadArenaState(const ArenaState &state);
+
+/// Allocate n zeroed bytes outside every world's arena, for the rest of the
+/// program; nullptr if out of memory
+uint8_t *permanentAlloc(unsigned long n);
+
 // =============================================================================
 // Minimal Libc Replacements
 // =============================================================================
 
+#if defined(__wasm__)
+/// Placement new, for constructing objects in arena memory
+inline void *operator new(unsigned long, void *p) noexcept { return p; }
+
 inline int abs(int x) { return x < 0 ? -x : x; }
 inline double abs(double x) { return x < 0 ? -x : x; }
 
@@ -106,6 +185,27 @@ inline void *memcpy(void *dst, const void *src, unsigned long n) {
   return dst;
 }
 
+inline void *memmove(void *dst, const void *src, unsigned long n) {
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  if (d < s)
+    while (n--)
+      *d++ = *s++;
+  else
+    while (n--)
+      d[n] = s[n];
+  return dst;
+}
+
+inline int memcmp(const void *a, const void *b, unsigned long n) {
+  const uint8_t *p = (const uint8_t *)a;
+  const uint8_t *q = (const uint8_t *)b;
+  for (; n--; p++, q++)
+    if (*p != *q)
+      return *p - *q;
+  return 0;
+}
+
 inline unsigned long strlen(const char *s) {
   unsigned long len = 0;
   while (*s++)
@@ -121,6 +221,7 @@ inline char *strncpy(char *dst, const char *src, unsigned long n) {
     *d++ = 0;
   return dst;
 }
+#endif
 
 // =============================================================================
 // Graphics Functions (implemented in main.cpp)
@@ -129,6 +230,12 @@ inline char *strncpy(char *dst, const char *src, unsigned long n) {
 /// Draw a single pixel at (x, y) with color c
 void putpixel(int x, int y, int c);
 
+/// Packed RGBA colour (as stored in the video buffer) of palette index c
+uint32_t paletteColor(int c);
+
+/// Copy a w x h block of packed pixels (row-major) to the screen at (x, y)
+void blit(int x, int y, int w, int h, const uint32_t *pixels);
+
 /// Fill a rectangle with the default bar color
 void bar(int x1, int y1, int x2, int y2);
 
@@ -0,0 +1,24 @@
+/**
+ * @file platform_native.cpp
+ * @brief Native stand-ins for the JS imports
+ *
+ * docs/sim.js provides console_log and get_time_ms to the WASM
+ * module. This file implements them on top of libc so the same sources can
+ * be linked into ordinary executables for benchmarking and profiling.
+ */
+
+#include "platform.h"
+
+#include <stdio.h>
+#include <time.h>
+
+extern "C" {
+
+void console_log(int val) { fprintf(stderr, "%d\n", val); }
+
+double get_time_ms() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+}
@@ -0,0 +1,556 @@
+/**
+ * @file replay.cpp
+ * @brief Input log recorder and replayer, and the exported API
+ *
+ * See replay.h for the log layout.
+ */
+
+#include "replay.h"
+#include "game.h"
+#include "rng.h"
+#include "sim.h"
+#include "snapshot.h"
+
+/// Largest entry the recorder writes (a frame of INPUT_QUEUE_SIZE events)
+constexpr int MAX_ENTRY_SIZE = 16 + INPUT_QUEUE_SIZE * 12;
+
+// Recorder
+static uint8_t *record_buf;
+static int record_size;
+static bool recording, record_overflow;
+static int record_step;            ///< Step counter at the last entry
+static int run_steps, run_count;   ///< Pending run of frames without events
+
+// Replayer
+static uint8_t *replay_buf; ///< Buffer handed out by replay_buffer()
+static int replay_capacity;
+static const uint8_t *replay_log;
+static int replay_size;
+static int replay_pos, replay_chunk_end; ///< Next entry, end of its chunk
+static bool entry_pending;               ///< entry_* hold an entry to apply
+static int steps_left;                   ///< Steps before it applies
+static int repeat_steps, repeats_left;   ///< Rest of an 'R' entry
+static bool replay_ended = true;
+static int replay_length, replay_checkpoints, replay_mismatches;
+
+/// The pending entry: its tag ('C' for a checkpoint chunk), the log offsets
+/// of a frame's events or of a checkpoint, and a setting
+static int entry_tag, entry_start, entry_end, entry_count;
+static int entry_setting, entry_value;
+
+/// One frame of replayed events
+static InputEvent replay_events[INPUT_QUEUE_SIZE];
+
+void saveReplayState(ReplayState *state) {
+  state->recordBuf = record_buf;
+  state->recordSize = record_size;
+  state->recording = recording;
+  state->overflow = record_overflow;
+  state->recordStep = record_step;
+  state->runSteps = run_steps;
+  state->runCount = run_count;
+  state->buffer = replay_buf;
+  state->capacity = replay_capacity;
+  state->log = replay_log;
+  state->logSize = replay_size;
+  state->pos = replay_pos;
+  state->chunkEnd = replay_chunk_end;
+  state->pending = entry_pending;
+  state->stepsLeft = steps_left;
+  state->repeatSteps = repeat_steps;
+  state->repeatsLeft = repeats_left;
+  state->ended = replay_ended;
+  state->length = replay_length;
+  state->checkpoints = replay_checkpoints;
+  state->mismatches = replay_mismatches;
+  state->entryTag = entry_tag;
+  state->entryStart = entry_start;
+  state->entryEnd = entry_end;
+  state->entryCount = entry_count;
+  state->entrySetting = entry_setting;
+  state->entryValue = entry_value;
+}
+
+void loadReplayState(const ReplayState &state) {
+  record_buf = state.recordBuf;
+  record_size = state.recordSize;
+  recording = state.recording;
+  record_overflow = state.overflow;
+  record_step = state.recordStep;
+  run_steps = state.runSteps;
+  run_count = state.runCount;
+  replay_buf = state.buffer;
+  replay_capacity = state.capacity;
+  replay_log = state.log;
+  replay_size = state.logSize;
+  replay_pos = state.pos;
+  replay_chunk_end = state.chunkEnd;
+  entry_pending = state.pending;
+  steps_left = state.stepsLeft;
+  repeat_steps = state.repeatSteps;
+  repeats_left = state.repeatsLeft;
+  replay_ended = state.ended;
+  replay_length = state.length;
+  replay_checkpoints = state.checkpoints;
+  replay_mismatches = state.mismatches;
+  entry_tag = state.entryTag;
+  entry_start = state.entryStart;
+  entry_end = state.entryEnd;
+  entry_count = state.entryCount;
+  entry_setting = state.entrySetting;
+  entry_value = state.entryValue;
+}
+
+void resetReplay() { loadReplayState(ReplayState{}); }
+
+// =============================================================================
+// Recorder
+// =============================================================================
+
+static void putByte(int v) { record_buf[record_size++] = (uint8_t)v; }
+
+static void putVarint(uint32_t v) {
+  for (; v > 0x7F; v >>= 7)
+    putByte((int)(v & 0x7F) | 0x80);
+  putByte((int)v);
+}
+
+static void putZigzag(int v) {
+  putVarint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+/// Room for one more entry; marks the recording lost otherwise
+static bool reserve() {
+  if (record_size + MAX_ENTRY_SIZE > RECORD_BUFFER_SIZE)
+    record_overflow = true;
+  return !record_overflow;
+}
+
+/// Write the pending run of frames without events
+static void flushRun() {
+  if (run_count == 0)
+    return;
+  if (reserve()) {
+    putVarint((uint32_t)run_steps);
+    putByte('R');
+    putVarint((uint32_t)run_count);
+  }
+  run_count = 0;
+}
+
+/// Start an entry: the steps since the previous one
+static bool beginEntry(int tag) {
+  flushRun();
+  if (!reserve())
+    return false;
+  putVarint((uint32_t)(game.frames - record_step));
+  putByte(tag);
+  record_step = game.frames;
+  return true;
+}
+
+void recordInput(const InputEvent *events, int count) {
+  if (!recording)
+    return;
+  if (count == 0) {
+    int steps = game.frames - record_step;
+    if (run_count > 0 && steps != run_steps)
+      flushRun();
+    run_steps = steps;
+    run_count++;
+    record_step = game.frames;
+    return;
+  }
+  if (!beginEntry('F'))
+    return;
+  putVarint((uint32_t)count);
+  for (int i = 0; i < count; i++) {
+    const InputEvent &e = events[i];
+    putByte(e.pointer);
+    putByte(e.buttons);
+    putZigzag(e.x);
+    putZigzag(e.y);
+  }
+}
+
+void recordSetting(Setting setting, int value) {
+  if (!recording || !beginEntry('S'))
+    return;
+  putByte((int)setting);
+  putZigzag(value);
+}
+
+void recordCheckpoint() {
+  if (!recording)
+    return;
+  flushRun();
+  record_step = game.frames;
+}
+
+// =============================================================================
+// Log Reading
+// =============================================================================
+
+/// Reader over the log; reading past `end` yields zeros and clears ok
+struct LogReader {
+  const uint8_t *data;
+  int pos, end;
+  bool ok = true;
+
+  int u8() {
+    if (pos >= end) {
+      ok = false;
+      return 0;
+    }
+    return data[pos++];
+  }
+  uint32_t u32() {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+      v |= (uint32_t)u8() << shift;
+    return v;
+  }
+  uint32_t varint() {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+      int b = u8();
+      v |= (uint32_t)(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        break;
+    }
+    return v;
+  }
+  int zigzag() {
+    uint32_t v = varint();
+    return (int)(v >> 1) ^ -(int)(v & 1);
+  }
+};
+
+/// Check the magic; false if data is not a log
+static bool checkMagic(const uint8_t *data, int size) {
+  return size >= 4 && data[0] == 'S' && data[1] == 'L' && data[2] == 'R' &&
+         data[3] == '1';
+}
+
+/// Read the chunk header at r.pos: its type, payload start and end
+static bool readChunk(LogReader &r, int *type, int *start, int *end) {
+  *type = r.u8();
+  uint32_t size = r.u32();
+  if (!r.ok || size > (uint32_t)(r.end - r.pos))
+    return false;
+  *start = r.pos;
+  *end = r.pos + (int)size;
+  return true;
+}
+
+/// Step counter of a checkpoint record: after the 9-byte header and the
+/// first four fields of the game state (see snapshot.h)
+static int checkpointStep(const uint8_t *record, int size) {
+  LogReader r{record, 13, size};
+  return (int)r.u32();
+}
+
+/// Skip one entry; false at the end of the session or if it is malformed
+static bool skipEntry(LogReader &r, int *steps) {
+  uint32_t s = r.varint();
+  int tag = r.u8();
+  *steps = (int)s;
+  if (tag == 'F') {
+    int n = (int)r.varint();
+    for (int i = 0; i < n && r.ok; i++) {
+      r.u8();
+      r.u8();
+      r.varint();
+      r.varint();
+    }
+  } else if (tag == 'R') {
+    *steps = (int)(s * r.varint());
+  } else if (tag == 'S') {
+    r.u8();
+    r.varint();
+  } else {
+    return false;
+  }
+  return r.ok;
+}
+
+bool replayFieldSize(const uint8_t *data, int size, int *width, int *height) {
+  LogReader r{data, 4, size};
+  int type, start, end;
+  if (!checkMagic(data, size) || !readChunk(r, &type, &start, &end) ||
+      type != 'C' || end - start < 9)
+    return false;
+  *width = data[start + 5] | data[start + 6] << 8;
+  *height = data[start + 7] | data[start + 8] << 8;
+  return true;
+}
+
+/// Step counter at the end of the log
+static int measureLog() {
+  LogReader r{replay_log, 4, replay_size};
+  int step = 0;
+  while (r.pos < r.end) {
+    int type, start, end;
+    if (!readChunk(r, &type, &start, &end))
+      break;
+    if (type == 'C') {
+      step = checkpointStep(replay_log + start, end - start);
+    } else if (type == 'I') {
+      LogReader entries{replay_log, start, end};
+      int steps;
+      while (entries.pos < end && skipEntry(entries, &steps))
+        step += steps;
+      if (!entries.ok)
+        break;
+      if (entries.pos < end) // 'E'
+        return step + steps;
+    }
+    r.pos = end;
+  }
+  return step;
+}
+
+// =============================================================================
+// Replayer
+// =============================================================================
+
+/// Read the next entry into entry_*; false at the end of the log or if it
+/// is malformed. A checkpoint chunk reads as a 'C' entry that applies at
+/// the checkpoint's step counter.
+static bool nextEntry() {
+  LogReader r{replay_log, replay_pos, replay_size};
+  while (r.pos >= replay_chunk_end) {
+    int type, start, end;
+    if (r.pos >= replay_size || !readChunk(r, &type, &start, &end))
+      return false;
+    if (type == 'C') {
+      int at = checkpointStep(replay_log + start, end - start);
+      steps_left = at > game.frames ? at - game.frames : 0;
+      entry_tag = 'C';
+      entry_start = start;
+      entry_end = end;
+      replay_pos = replay_chunk_end = end;
+      entry_pending = true;
+      return true;
+    }
+    if (type == 'I')
+      replay_chunk_end = end;
+    else
+      r.pos = end; // unknown chunk
+  }
+
+  r.end = replay_chunk_end;
+  steps_left = (int)r.varint();
+  entry_tag = r.u8();
+  if (entry_tag == 'F') {
+    entry_count = (int)r.varint();
+    entry_start = r.pos;
+    for (int i = 0; i < entry_count && r.ok; i++) {
+      r.u8();
+      r.u8();
+      r.varint();
+      r.varint();
+    }
+    entry_end = r.pos;
+    if (entry_count > INPUT_QUEUE_SIZE)
+      return false;
+  } else if (entry_tag == 'R') {
+    repeat_steps = steps_left;
+    repeats_left = (int)r.varint() - 1;
+    if (repeats_left < 0)
+      return false;
+  } else if (entry_tag == 'S') {
+    entry_setting = r.u8();
+    entry_value = r.zigzag();
+  } else if (entry_tag != 'E') {
+    return false;
+  }
+  replay_pos = r.pos;
+  entry_pending = true;
+  return r.ok;
+}
+
+/// Apply the pending entry's input
+static void applyEntry() {
+  if (entry_tag == 'C') {
+    replay_checkpoints++;
+    if (!checkpointMatches(replay_log + entry_start, entry_end - entry_start))
+      replay_mismatches++;
+  } else if (entry_tag == 'F') {
+    LogReader r{replay_log, entry_start, entry_end};
+    for (int i = 0; i < entry_count; i++) {
+      InputEvent &e = replay_events[i];
+      e.time = 0;
+      e.pointer = r.u8();
+      e.buttons = r.u8();
+      e.x = r.zigzag();
+      e.y = r.zigzag();
+    }
+    applyInput(replay_events, entry_count);
+  } else if (entry_tag == 'R') {
+    applyInput(nullptr, 0);
+  } else if (entry_tag == 'S') {
+    int value = entry_value;
+    if (entry_setting == (int)Setting::SimMode)
+      set_sim_mode(value);
+    else if (entry_setting == (int)Setting::SleepTiles)
+      set_sleep_tiles(value);
+    else if (entry_setting == (int)Setting::Seed)
+      seed_random((uint32_t)value);
+    else
+      set_param(entry_setting - (int)Setting::Param, value);
+  }
+}
+
+/// Go on from the checkpoint chunk ending at chunkEnd, once it is loaded
+static void startAfter(int chunkEnd) {
+  replay_pos = replay_chunk_end = chunkEnd;
+  entry_pending = false;
+  repeats_left = 0;
+  replay_ended = false;
+}
+
+bool openReplay(const uint8_t *data, int size) {
+  close_replay();
+  recording = false;
+  LogReader r{data, 4, size};
+  int type, start, end;
+  if (!checkMagic(data, size) || !readChunk(r, &type, &start, &end) ||
+      type != 'C' || !loadSnapshot(data + start, end - start))
+    return false;
+  replay_log = data;
+  replay_size = size;
+  replay_checkpoints = replay_mismatches = 0;
+  replay_length = measureLog();
+  startAfter(end);
+  return true;
+}
+
+extern "C" {
+
+int start_recording() {
+  if (!replay_ended)
+    return 0;
+  if (!record_buf)
+    record_buf = arenaAlloc(RECORD_BUFFER_SIZE);
+  if (!record_buf)
+    return 0;
+  recording = true;
+  record_overflow = false;
+  record_size = run_count = 0;
+  record_step = game.frames;
+  // Older checkpoints leave this out
+  recordSetting(Setting::SleepTiles, sleepTiles);
+  return 1;
+}
+
+void stop_recording() {
+  if (!recording)
+    return;
+  beginEntry('E');
+  recording = false;
+}
+
+int is_recording() { return recording; }
+
+int take_recording() {
+  int size = record_overflow ? -1 : record_size;
+  record_size = 0;
+  record_overflow = false;
+  return size;
+}
+
+uint8_t *get_recording_buffer() { return record_buf; }
+
+uint8_t *replay_buffer(int size) {
+  if (size <= 0)
+    return nullptr;
+  close_replay(); // its log is about to be overwritten
+  // Reused for every log; the arena cannot free, so it only ever grows
+  if (size > replay_capacity) {
+    uint8_t *buffer = arenaAlloc((unsigned long)size);
+    if (!buffer)
+      return nullptr;
+    replay_buf = buffer;
+    replay_capacity = size;
+  }
+  return replay_buf;
+}
+
+int open_replay(int size) {
+  return replay_buf && size <= replay_capacity &&
+         openReplay(replay_buf, size);
+}
+
+int replay_to(int step) {
+  while (!replay_ended) {
+    if (!entry_pending && !nextEntry()) {
+      replay_ended = true;
+      break;
+    }
+    if (game.frames + steps_left > step) {
+      int n = step - game.frames;
+      if (n > 0)
+        steps_left -= fast_forward(n, 0);
+      break;
+    }
+    fast_forward(steps_left, 0);
+    steps_left = 0;
+    if (entry_tag == 'E') {
+      replay_ended = true;
+      break;
+    }
+    applyEntry();
+    if (repeats_left > 0) {
+      repeats_left--;
+      steps_left = repeat_steps;
+    } else {
+      entry_pending = false;
+    }
+  }
+  return game.frames;
+}
+
+int seek_replay(int step) {
+  if (!replay_log)
+    return game.frames;
+  // Last checkpoint at or before step
+  LogReader r{replay_log, 4, replay_size};
+  int best = -1, bestStart = 0, bestEnd = 0;
+  while (r.pos < r.end) {
+    int type, start, end;
+    if (!readChunk(r, &type, &start, &end))
+      break;
+    if (type == 'C') {
+      int at = checkpointStep(replay_log + start, end - start);
+      if (at > step)
+        break;
+      best = at;
+      bestStart = start;
+      bestEnd = end;
+    }
+    r.pos = end;
+  }
+  bool ahead = !replay_ended && game.frames <= step && game.frames >= best;
+  if (!ahead && best >= 0 &&
+      loadSnapshot(replay_log + bestStart, bestEnd - bestStart))
+    startAfter(bestEnd);
+  return replay_to(step);
+}
+
+int get_replay_length() { return replay_length; }
+
+int replay_done() { return replay_ended; }
+
+int get_replay_checkpoints() { return replay_checkpoints; }
+
+int get_replay_mismatches() { return replay_mismatches; }
+
+void close_replay() {
+  replay_log = nullptr;
+  replay_size = 0;
+  entry_pending = false;
+  replay_ended = true;
+}
+
+} // extern "C"
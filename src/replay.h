@@ -0,0 +1,163 @@
+/**
+ * @file replay.h
+ * @brief Recording the input a run receives, and replaying it
+ *
+ * A run is decided by the world it starts from and by what happens at each
+ * frame boundary: the pointer events processInput() applies (see main.cpp)
+ * and the settings the host changes. Rain and the water brush draw from the
+ * seeded generator, whose state is part of every checkpoint. The recorder
+ * logs both kinds of input together with the number of steps run before
+ * them, and the replayer feeds the same input to the engine after the same
+ * steps, so a session plays back bit for bit whatever frame rate or speed it
+ * was recorded at, in the browser or headless (tools/replay.cpp).
+ *
+ * A log is a sequence of chunks:
+ *
+ *     "SLR1"  magic and version
+ *     chunks  u8 type, u32 payload size (little-endian), payload
+ *       'C'   a checkpoint: snapshot record of kind 'C' (see snapshot.h)
+ *       'I'   input entries
+ *
+ * The first chunk is a checkpoint, the world the session starts from. More
+ * checkpoints follow every so often, so that seeking does not have to
+ * replay the session from the start, and so that a replay can check it is
+ * still in step. Entries after a checkpoint count steps from its step
+ * counter.
+ *
+ * Input entry:
+ *
+ *     varint  steps run since the previous entry
+ *     u8      tag
+ *       'F'   a frame: varint n, then n pointer events, each u8 pointer,
+ *             u8 buttons, zigzag varint x, zigzag varint y
+ *       'R'   varint r: r frames without events, each that many steps
+ *             after the one before
+ *       'S'   a setting: u8 Setting, zigzag varint value
+ *       'E'   end of the session
+ *
+ * Varints are LEB128 and zigzag maps 0, -1, 1, -2 ... to 0, 1, 2, 3 ...;
+ * event times are not kept. Most frames of a session have no events, so
+ * they cost a few bytes per run of them.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "input.h"
+
+/// Record-buffer size; take_recording() has to be called before it fills up
+constexpr int RECORD_BUFFER_SIZE = 64 * 1024;
+
+/// Settings an 'S' entry changes. Setting::Param + p is parameter p (see
+/// Param in sim.h).
+enum class Setting : uint8_t { SimMode, SleepTiles, Seed, Param };
+
+/// Forget recording and replay; the arena is reset. Called by init().
+void resetReplay();
+
+/// Log one frame of input while recording (called by processInput())
+void recordInput(const InputEvent *events, int count);
+
+/// Log a settings change while recording (called by the setters)
+void recordSetting(Setting setting, int value);
+
+/// Start the input that follows a new checkpoint (called by
+/// save_checkpoint())
+void recordCheckpoint();
+
+/// Size of the field the log was recorded on; false if data is not a log
+bool replayFieldSize(const uint8_t *data, int size, int *width, int *height);
+
+/**
+ * @brief Start replaying the log in data, which must outlive the replay
+ *
+ * Loads the first checkpoint into the world; false if the log is malformed
+ * or was recorded on a field of another size.
+ */
+bool openReplay(const uint8_t *data, int size);
+
+/// Recorder and replayer of one world (see context.cpp)
+struct ReplayState {
+  uint8_t *recordBuf = nullptr;
+  int recordSize = 0;
+  bool recording = false, overflow = false;
+  int recordStep = 0, runSteps = 0, runCount = 0;
+  uint8_t *buffer = nullptr;
+  int capacity = 0;
+  const uint8_t *log = nullptr;
+  int logSize = 0, pos = 0, chunkEnd = 0;
+  bool pending = false;
+  int stepsLeft = 0, repeatSteps = 0, repeatsLeft = 0;
+  bool ended = true;
+  int length = 0, checkpoints = 0, mismatches = 0;
+  int entryTag = 0, entryStart = 0, entryEnd = 0, entryCount = 0;
+  int entrySetting = 0, entryValue = 0;
+};
+
+/// Copy the live replay state out (to switch worlds) and back in
+void saveReplayState(ReplayState *state);
+void loadReplayState(const ReplayState &state);
+
+// =============================================================================
+// Exported API (called from JavaScript)
+// =============================================================================
+//
+// Recording: start_recording(), then save_checkpoint() for the first chunk.
+// From then on the host calls take_recording() every so often and appends
+// the bytes as an 'I' chunk; for a further checkpoint it calls
+// save_checkpoint() first and appends the 'I' chunk before the 'C' one.
+// stop_recording() ends the session with a last take_recording().
+
+extern "C" {
+/// Start logging input; 0 while a replay is open or out of memory
+int start_recording();
+
+/// Log the end of the session and stop; the host takes the rest with
+/// take_recording()
+void stop_recording();
+
+int is_recording();
+
+/// Size of the input logged since the last call, now at
+/// get_recording_buffer(), and start over; -1 if the buffer overflowed
+/// (the recording is lost)
+int take_recording();
+
+uint8_t *get_recording_buffer();
+
+/// Buffer of `size` bytes to copy a log into for open_replay(); valid until
+/// the next init(). The same buffer is handed out again unless a larger one
+/// is needed, so any open replay is closed.
+uint8_t *replay_buffer(int size);
+
+/// Open the log of the given size in replay_buffer(); 1 on success
+int open_replay(int size);
+
+/**
+ * @brief Replay up to step counter `step`, applying the input logged at it;
+ * returns the step counter reached
+ *
+ * That is less than `step` only at the end of the log. Checkpoints passed
+ * on the way are compared with the world (see get_replay_mismatches()).
+ */
+int replay_to(int step);
+
+/// Jump to step counter `step` from the last checkpoint at or before it (or
+/// from where the replay is, if that is closer); returns the step reached
+int seek_replay(int step);
+
+/// Step counter at the end of the log
+int get_replay_length();
+
+/// 1 once the whole log has been replayed
+int replay_done();
+
+/// Checkpoints passed and of those, the ones the world did not match
+int get_replay_checkpoints();
+int get_replay_mismatches();
+
+/// Stop replaying; the world stays as it is
+void close_replay();
+}
+
+#endif
@@ -0,0 +1,83 @@
+/**
+ * @file rng.cpp
+ * @brief xoshiro128** generator, seeded with splitmix32
+ */
+
+#include "rng.h"
+
+/// splitmix32 output function, used to spread a seed over the generator state
+static constexpr uint32_t splitmix32(uint32_t z) {
+  z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+  z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+  return z ^ (z >> 16);
+}
+
+constexpr uint32_t GOLDEN = 0x9E3779B9u; ///< splitmix32 increment
+
+// State for seed 0 until seedRandom() is called. splitmix32 is a bijection,
+// so at most one word is zero and the state can never be all zeros.
+static uint32_t rng_state[4] = {splitmix32(GOLDEN), splitmix32(GOLDEN * 2),
+                                splitmix32(GOLDEN * 3), splitmix32(GOLDEN * 4)};
+static uint32_t rng_seed = 0;
+
+static inline uint32_t rotl(uint32_t x, int k) {
+  return (x << k) | (x >> (32 - k));
+}
+
+void seedRandom(uint32_t seed) {
+  rng_seed = seed;
+  for (int i = 0; i < 4; i++)
+    rng_state[i] = splitmix32(seed + GOLDEN * (i + 1));
+}
+
+uint32_t randomSeed() { return rng_seed; }
+
+uint32_t nextRandom() {
+  uint32_t *s = rng_state;
+  uint32_t result = rotl(s[1] * 5, 7) * 9;
+  uint32_t t = s[1] << 9;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 11);
+  return result;
+}
+
+int randomInt(int max) {
+  if (max <= 0)
+    return 0;
+  // Multiply-shift maps 32 random bits onto [0, max) without a division
+  return (int)(((uint64_t)nextRandom() * (uint32_t)max) >> 32);
+}
+
+void randomFill(uint32_t *out, int n) {
+  // Keep the state in locals so the loop does not store it every word
+  uint32_t s0 = rng_state[0], s1 = rng_state[1], s2 = rng_state[2],
+           s3 = rng_state[3];
+  for (int i = 0; i < n; i++) {
+    out[i] = rotl(s1 * 5, 7) * 9;
+    uint32_t t = s1 << 9;
+    s2 ^= s0;
+    s3 ^= s1;
+    s1 ^= s2;
+    s0 ^= s3;
+    s2 ^= t;
+    s3 = rotl(s3, 11);
+  }
+  rng_state[0] = s0;
+  rng_state[1] = s1;
+  rng_state[2] = s2;
+  rng_state[3] = s3;
+}
+
+void saveRandomState(RngState *state) {
+  memcpy(state->state, rng_state, sizeof(rng_state));
+  state->seed = rng_seed;
+}
+
+void loadRandomState(const RngState &state) {
+  memcpy(rng_state, state.state, sizeof(rng_state));
+  rng_seed = state.seed;
+}
@@ -0,0 +1,41 @@
+/**
+ * @file rng.h
+ * @brief Seeded pseudo-random numbers generated inside the module
+ *
+ * xoshiro128** (Blackman and Vigna): 128 bits of state, 32-bit output, only
+ * 32-bit operations, so it is cheap in WASM and needs no call out to JS. The
+ * same seed always gives the same sequence, on every platform, which makes
+ * runs reproducible.
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include "platform.h"
+
+/// Restart the sequence from a 32-bit seed
+void seedRandom(uint32_t seed);
+
+/// Seed last passed to seedRandom()
+uint32_t randomSeed();
+
+/// Next 32 random bits
+uint32_t nextRandom();
+
+/// Uniform integer in [0, max), or 0 if max <= 0
+int randomInt(int max);
+
+/// Fill out[0..n-1] with random 32-bit words
+void randomFill(uint32_t *out, int n);
+
+/// Generator state of one world (see context.cpp)
+struct RngState {
+  uint32_t state[4];
+  uint32_t seed;
+};
+
+/// Copy the live generator state out (to switch worlds) and back in
+void saveRandomState(RngState *state);
+void loadRandomState(const RngState &state);
+
+#endif
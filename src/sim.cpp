@@ -0,0 +1,1148 @@
+/**
+ * @file sim.cpp
+ * @brief Water flow kernels
+ *
+ * See sim.h for a description of the update schemes and sleeping tiles.
+ */
+
+#include "sim.h"
+#include "game.h"
+#include "simd.h"
+#include "threads.h"
+
+SimMode simMode = SimMode::InPlace;
+bool sleepTiles = true;
+SimParams simParams;
+int temporalSteps = 1;
+bool sweepOdd = false;
+
+// =============================================================================
+// Sleeping tiles
+// =============================================================================
+
+int tilesX, tilesY;
+
+/// Tiles the kernels update this step (tilesX x tilesY)
+static Grid tile_awake;
+
+/// Tiles whose cells may change this step: awake tiles and their neighbours,
+/// which awake cells can flow into
+static Grid tile_live;
+
+/// Tiles that changed in the last step
+static Grid tile_changed;
+
+/// Number of tiles set in tile_changed (every tile with sleeping tiles off)
+static int changed_tiles;
+
+/// Tiles whose pixels must be repainted and presented in the next frame
+static Grid tile_dirty;
+
+/// Tiles whose cells may differ from the last saved snapshot (snapshot.h)
+static Grid tile_unsaved;
+
+/// Copy of the live tiles taken before the step, to detect change
+static Grid field_prev;
+
+/// Flow direction chosen by each cell in the current Jacobi pass. Border
+/// entries are never written and stay DIR_NONE.
+static Grid flow_dir;
+
+/// Intermediate field between Jacobi pass 1 and pass 2
+static Grid field_next;
+
+
+/// Per-band working buffers of the temporally tiled kernel, allocated on
+/// first use (see simulateBlocks())
+static uint8_t *block_scratch;
+static int scratch_bands;
+
+void saveSimState(SimState *state) {
+  state->simMode = simMode;
+  state->params = simParams;
+  state->temporalSteps = temporalSteps;
+  state->sweepOdd = sweepOdd;
+  state->sleepTiles = sleepTiles;
+  state->tilesX = tilesX;
+  state->tilesY = tilesY;
+  state->tile_awake = tile_awake;
+  state->tile_live = tile_live;
+  state->tile_changed = tile_changed;
+  state->changedTiles = changed_tiles;
+  state->tile_dirty = tile_dirty;
+  state->tile_unsaved = tile_unsaved;
+  state->field_prev = field_prev;
+  state->flow_dir = flow_dir;
+  state->field_next = field_next;
+  state->blockScratch = block_scratch;
+  state->scratchBands = scratch_bands;
+}
+
+void loadSimState(const SimState &state) {
+  simMode = state.simMode;
+  simParams = state.params;
+  temporalSteps = state.temporalSteps;
+  sweepOdd = state.sweepOdd;
+  sleepTiles = state.sleepTiles;
+  tilesX = state.tilesX;
+  tilesY = state.tilesY;
+  tile_awake = state.tile_awake;
+  tile_live = state.tile_live;
+  tile_changed = state.tile_changed;
+  changed_tiles = state.changedTiles;
+  tile_dirty = state.tile_dirty;
+  tile_unsaved = state.tile_unsaved;
+  field_prev = state.field_prev;
+  flow_dir = state.flow_dir;
+  field_next = state.field_next;
+  block_scratch = state.blockScratch;
+  scratch_bands = state.scratchBands;
+}
+
+/// First and last interior column (the columns the kernels update) of tile
+/// column tx
+static inline int tileLeft(int tx) { return tx == 0 ? 1 : tx * TILE_SIZE; }
+static inline int tileRight(int tx) {
+  int x = tx * TILE_SIZE + TILE_SIZE - 1;
+  return x > screenWidth - 2 ? screenWidth - 2 : x;
+}
+
+/// First and last interior row of tile row ty
+static inline int tileTop(int ty) { return ty == 0 ? 1 : ty * TILE_SIZE; }
+static inline int tileBottom(int ty) {
+  int y = ty * TILE_SIZE + TILE_SIZE - 1;
+  return y > screenHeight - 2 ? screenHeight - 2 : y;
+}
+
+/**
+ * @brief Visit each run of consecutive tiles in a tile column whose flag
+ * equals `want`, as an interior row range [lo, hi]
+ *
+ * Runs are visited top to bottom, or bottom to top if `bottomUp` is set (the
+ * in-place kernel sweeps y descending).
+ */
+template <typename Fn>
+static inline void forEachRun(const uint8_t *flags, bool want, Fn &&visit,
+                              bool bottomUp = false) {
+  if (bottomUp) {
+    for (int ty = tilesY - 1; ty >= 0; ty--) {
+      if ((flags[ty] != 0) != want)
+        continue;
+      int last = ty;
+      while (ty > 0 && (flags[ty - 1] != 0) == want)
+        ty--;
+      visit(tileTop(ty), tileBottom(last));
+    }
+    return;
+  }
+  for (int ty = 0; ty < tilesY; ty++) {
+    if ((flags[ty] != 0) != want)
+      continue;
+    int first = ty;
+    while (ty + 1 < tilesY && (flags[ty + 1] != 0) == want)
+      ty++;
+    visit(tileTop(first), tileBottom(ty));
+  }
+}
+
+bool initSim() {
+  sweepOdd = false;
+  tilesX = (screenWidth + TILE_SIZE - 1) / TILE_SIZE;
+  tilesY = (screenHeight + TILE_SIZE - 1) / TILE_SIZE;
+  if (!arenaGrid(&tile_awake, tilesX, tilesY) ||
+      !arenaGrid(&tile_live, tilesX, tilesY) ||
+      !arenaGrid(&tile_changed, tilesX, tilesY) ||
+      !arenaGrid(&tile_dirty, tilesX, tilesY) ||
+      !arenaGrid(&tile_unsaved, tilesX, tilesY) ||
+      !arenaGrid(&field_prev, screenWidth, screenHeight) ||
+      !arenaGrid(&flow_dir, screenWidth, screenHeight) ||
+      !arenaGrid(&field_next, screenWidth, screenHeight))
+    return false;
+  block_scratch = nullptr;
+  scratch_bands = 0;
+  changed_tiles = 0;
+  wakeAll();
+  return true;
+}
+
+/// Set the flags of the tiles covering cells (x1, y1)-(x2, y2) (inclusive,
+/// x1 <= x2 and y1 <= y2, clipped to the screen)
+static void setTiles(const Grid &tiles, int x1, int y1, int x2, int y2,
+                     uint8_t value = 1) {
+  if (x2 < 0 || y2 < 0 || x1 >= screenWidth || y1 >= screenHeight)
+    return;
+  int tx1 = x1 < 0 ? 0 : x1 / TILE_SIZE;
+  int ty1 = y1 < 0 ? 0 : y1 / TILE_SIZE;
+  int tx2 = x2 >= screenWidth ? tilesX - 1 : x2 / TILE_SIZE;
+  int ty2 = y2 >= screenHeight ? tilesY - 1 : y2 / TILE_SIZE;
+  for (int tx = tx1; tx <= tx2; tx++)
+    for (int ty = ty1; ty <= ty2; ty++)
+      tiles[tx][ty] = value;
+}
+
+void wakeAll() {
+  memset(tile_awake.cells, 1, tilesX * tilesY);
+  memset(tile_unsaved.cells, UNSAVED_ALL, tilesX * tilesY);
+  markAllDirty();
+}
+
+void wakeRect(int x1, int y1, int x2, int y2) {
+  if (x1 > x2)
+    swap(&x1, &x2);
+  if (y1 > y2)
+    swap(&y1, &y2);
+  // Grow by a step's reach: cells that far from an edit see new inputs too
+  setTiles(tile_awake, x1 - STEP_RADIUS, y1 - STEP_RADIUS, x2 + STEP_RADIUS,
+           y2 + STEP_RADIUS);
+  setTiles(tile_dirty, x1, y1, x2, y2);
+  setTiles(tile_unsaved, x1, y1, x2, y2, UNSAVED_ALL);
+}
+
+bool tileUnsaved(int tx, int ty, uint8_t user) {
+  return tile_unsaved[tx][ty] & user;
+}
+
+void markTileSaved(int tx, int ty, uint8_t user) {
+  tile_unsaved[tx][ty] &= ~user;
+}
+
+void markAllSaved(uint8_t user) {
+  for (int i = 0; i < tilesX * tilesY; i++)
+    tile_unsaved.cells[i] &= ~user;
+}
+
+// =============================================================================
+// Dirty tiles
+// =============================================================================
+
+void markDirty(int x, int y) {
+  if (x >= 0 && y >= 0 && x < screenWidth && y < screenHeight)
+    tile_dirty[x / TILE_SIZE][y / TILE_SIZE] = 1;
+}
+
+void markDirtyRect(int x1, int y1, int x2, int y2) {
+  setTiles(tile_dirty, x1, y1, x2, y2);
+}
+
+void markAllDirty() { memset(tile_dirty.cells, 1, tilesX * tilesY); }
+
+int takeDirtyRects(int *rects) {
+  // Tile rectangles as {tx1, ty1, tx2, ty2}: runs of dirty tiles in each tile
+  // row, extending a rectangle from the row above that has the same span
+  int tileRects[MAX_DIRTY_RECTS][4];
+  int count = 0;
+  bool overflow = false;
+  for (int ty = 0; ty < tilesY && !overflow; ty++) {
+    for (int tx = 0; tx < tilesX; tx++) {
+      if (!tile_dirty[tx][ty])
+        continue;
+      int tx1 = tx;
+      while (tx + 1 < tilesX && tile_dirty[tx + 1][ty])
+        tx++;
+      int i = 0;
+      while (i < count && !(tileRects[i][0] == tx1 && tileRects[i][2] == tx &&
+                            tileRects[i][3] == ty - 1))
+        i++;
+      if (i < count) {
+        tileRects[i][3] = ty;
+      } else if (count == MAX_DIRTY_RECTS) {
+        overflow = true;
+        break;
+      } else {
+        int *r = tileRects[count++];
+        r[0] = tx1;
+        r[1] = ty;
+        r[2] = tx;
+        r[3] = ty;
+      }
+    }
+  }
+
+  if (overflow) {
+    // Too fragmented to be worth it: present the bounding box of all tiles
+    int b[4] = {tilesX, tilesY, -1, -1};
+    for (int tx = 0; tx < tilesX; tx++)
+      for (int ty = 0; ty < tilesY; ty++)
+        if (tile_dirty[tx][ty]) {
+          b[0] = tx < b[0] ? tx : b[0];
+          b[1] = ty < b[1] ? ty : b[1];
+          b[2] = tx > b[2] ? tx : b[2];
+          b[3] = ty > b[3] ? ty : b[3];
+        }
+    for (int k = 0; k < 4; k++)
+      tileRects[0][k] = b[k];
+    count = 1;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const int *r = tileRects[i];
+    int x = r[0] * TILE_SIZE, y = r[1] * TILE_SIZE;
+    int x2 = (r[2] + 1) * TILE_SIZE, y2 = (r[3] + 1) * TILE_SIZE;
+    rects[i * 4] = x;
+    rects[i * 4 + 1] = y;
+    rects[i * 4 + 2] = (x2 < screenWidth ? x2 : screenWidth) - x;
+    rects[i * 4 + 3] = (y2 < screenHeight ? y2 : screenHeight) - y;
+  }
+  memset(tile_dirty.cells, 0, tilesX * tilesY);
+  return count;
+}
+
+/// Number of set entries in a tile grid
+static int countTiles(const Grid &tiles) {
+  int count = 0;
+  for (int tx = 0; tx < tilesX; tx++)
+    for (int ty = 0; ty < tilesY; ty++)
+      count += tiles[tx][ty];
+  return count;
+}
+
+int countAwakeTiles() { return countTiles(tile_awake); }
+
+int countChangedTiles() { return changed_tiles; }
+
+/// True if any tile in the 3x3 block around (tx, ty) is set
+static bool anyNeighbour(const Grid &flags, int tx, int ty) {
+  for (int nx = tx - 1; nx <= tx + 1; nx++)
+    for (int ny = ty - 1; ny <= ty + 1; ny++)
+      if (nx >= 0 && nx < tilesX && ny >= 0 && ny < tilesY && flags[nx][ny])
+        return true;
+  return false;
+}
+
+/// Interior columns [x0, x1] of band `band` of `bands`. Bands are whole tile
+/// columns so per-tile bookkeeping never straddles two bands.
+static void bandColumns(int band, int bands, int *x0, int *x1) {
+  int tx0 = tilesX * band / bands, tx1 = tilesX * (band + 1) / bands;
+  *x0 = tileLeft(tx0);
+  *x1 = tx1 > tx0 ? tileRight(tx1 - 1) : *x0 - 1;
+}
+
+static void snapshotBand(int band, int bands) {
+  int x0, x1;
+  bandColumns(band, bands, &x0, &x1);
+  for (int x = x0; x <= x1; x++)
+    forEachRun(tile_live[x / TILE_SIZE], true, [&](int lo, int hi) {
+      memcpy(&field_prev[x][lo], &field[x][lo], hi - lo + 1);
+    });
+}
+
+/**
+ * @brief True if this step skips sleeping tiles and tracks which changed
+ *
+ * An in-place sweep is not exact with tiles skipped: an awake cell reads its
+ * sleeping neighbours as they were before the step, not as the sweep would
+ * have left them, and flow it passes on can travel further than one tile
+ * within a pass. So it always runs as with sleeping tiles off.
+ */
+static bool tracksTiles() {
+  return sleepTiles && simMode == SimMode::Jacobi;
+}
+
+/**
+ * @brief Work out which tiles may change this step and snapshot them
+ */
+static void prepareTiles() {
+  if (!tracksTiles()) {
+    wakeAll();
+    memset(tile_live.cells, 1, tilesX * tilesY);
+    return;
+  }
+  for (int tx = 0; tx < tilesX; tx++)
+    for (int ty = 0; ty < tilesY; ty++)
+      tile_live[tx][ty] = anyNeighbour(tile_awake, tx, ty);
+  parallelFor(snapshotBand);
+}
+
+/// True if any cell of a live tile differs from its snapshot
+static bool tileChanged(int tx, int ty) {
+  int lo = tileTop(ty), n = tileBottom(ty) - lo + 1;
+  for (int x = tileLeft(tx); x <= tileRight(tx); x++)
+    if (memcmp(&field_prev[x][lo], &field[x][lo], n))
+      return true;
+  return false;
+}
+
+static void compareBand(int band, int bands) {
+  for (int tx = tilesX * band / bands; tx < tilesX * (band + 1) / bands; tx++)
+    for (int ty = 0; ty < tilesY; ty++)
+      tile_changed[tx][ty] = tile_live[tx][ty] && tileChanged(tx, ty);
+}
+
+/// Keep the tiles that changed in the last step and their neighbours awake
+/// and put the rest to sleep
+static void updateAwake() {
+  for (int tx = 0; tx < tilesX; tx++)
+    for (int ty = 0; ty < tilesY; ty++)
+      tile_awake[tx][ty] = anyNeighbour(tile_changed, tx, ty);
+}
+
+/**
+ * @brief Put unchanged tiles to sleep and keep changed tiles and their
+ * neighbours awake
+ */
+static void settleTiles() {
+  if (!tracksTiles()) {
+    // No change detection: assume everything moved
+    markAllDirty();
+    memset(tile_unsaved.cells, UNSAVED_ALL, tilesX * tilesY);
+    changed_tiles = tilesX * tilesY;
+    return;
+  }
+  parallelFor(compareBand);
+  for (int i = 0; i < tilesX * tilesY; i++) {
+    tile_dirty.cells[i] |= tile_changed.cells[i];
+    tile_unsaved.cells[i] |= tile_changed.cells[i] * UNSAVED_ALL;
+  }
+  changed_tiles = countTiles(tile_changed);
+  updateAwake();
+}
+
+// =============================================================================
+// In-place (reference) kernel
+// =============================================================================
+
+/// Compile-time column step: +1 for the plain sweep, -1 for the mirrored
+/// one, so each gets its own specialized cell loop
+template <int D> struct ColumnStep {
+  constexpr operator int() const { return D; }
+};
+
+/// Visit the awake cells in tile rows [ty0, ty1] of every column, walking the
+/// columns in the given order and each column bottom to top
+template <typename Cell, typename Dx>
+static inline void sweepRange(bool ascending, int ty0, int ty1, Cell &cell,
+                              Dx dx) {
+  for (int i = 1; i < screenWidth - 1; i++) {
+    int x = ascending ? i : screenWidth - 1 - i;
+    const uint8_t *awake = tile_awake[x / TILE_SIZE];
+    for (int ty = ty1; ty >= ty0; ty--) {
+      if (!awake[ty])
+        continue;
+      int last = ty;
+      while (ty > ty0 && awake[ty - 1])
+        ty--;
+      for (int y = tileBottom(last); y >= tileTop(ty); y--)
+        cell(x, y, dx);
+    }
+  }
+}
+
+/**
+ * @brief Visit the awake cells of one in-place pass a column at a time
+ *
+ * Columns are swept left to right for pass 1 and right to left for pass 2,
+ * each bottom to top, as in the reference; a mirrored sweep reverses the
+ * column order and passes dx = -1 so that the cell swaps its left and right
+ * neighbours too.
+ */
+template <typename Cell>
+static inline void sweepColumns(bool firstPass, bool mirror, Cell &&cell) {
+  if (mirror)
+    sweepRange(!firstPass, 0, tilesY - 1, cell, ColumnStep<-1>());
+  else
+    sweepRange(firstPass, 0, tilesY - 1, cell, ColumnStep<1>());
+}
+
+/**
+ * @brief Visit the awake cells of one in-place pass in serpentine order
+ *
+ * Bands of TILE_SIZE rows are taken bottom to top, and every other band is
+ * swept mirrored, so the pass snakes back and forth across the field.
+ */
+template <typename Cell>
+static inline void sweepBands(bool firstPass, bool mirror, Cell &&cell) {
+  for (int ty = tilesY - 1; ty >= 0; ty--) {
+    if (mirror != (((tilesY - 1 - ty) & 1) != 0))
+      sweepRange(!firstPass, ty, ty, cell, ColumnStep<-1>());
+    else
+      sweepRange(firstPass, ty, ty, cell, ColumnStep<1>());
+  }
+}
+
+/**
+ * @brief Reference kernel: both passes update the field in place
+ *
+ * Pass 1 moves one unit of density from every water cell to its lowest
+ * neighbour (sweeping x ascending, y descending); pass 2 then moves up to
+ * densityFlow units sweeping x descending. Every tile is visited (see
+ * prepareTiles()).
+ *
+ * Because every cell sees the cells updated before it, the sweep order
+ * biases the flow. sweepOrder can alternate it between steps or snake it
+ * across the field (see SweepOrder).
+ */
+static void simulateInPlace() {
+  // Work on a local copy of the grid handle: byte stores into the cells may
+  // alias the global, which would reload its pointer and stride on every access
+  const Grid field = ::field;
+  const int maxWater = simParams.maxWater;
+  const int densityFlow = simParams.densityFlow;
+
+  // Pass 1: Decay/Flow (Forwards). dx is -1 in mirrored sweeps, where "left"
+  // and "right" trade places.
+  auto decay = [&](int x, int y, auto dx) {
+    if (field[x][y + 1] == 100 && field[x][y] != WALL_VALUE)
+      field[x][y] = 0; // Drain? (walls stand, see walls.h)
+
+    if ((field[x][y] > 0) && (field[x][y] < 99)) {
+      field[x][y]--; // Decay/Flow
+
+      int u = field[x][y - 1];
+      int d = field[x][y + 1];
+      int l = field[x - dx][y];
+      int r = field[x + dx][y];
+
+      int q = d;
+      int b = 2; // Default down
+
+      // Water logic: find lowest neighbor
+      if (u < q) {
+        q = u;
+        b = 1;
+      } // Up? (Pressure?)
+      if (l < q) {
+        q = l;
+        b = 3;
+      }
+      if (r < q) {
+        q = r;
+        b = 4;
+      }
+
+      // Move water
+      if (b == 1 && field[x][y - 1] < maxWater)
+        field[x][y - 1]++;
+      if (b == 2 && field[x][y + 1] < maxWater)
+        field[x][y + 1]++;
+      if (b == 3 && field[x - dx][y] < maxWater)
+        field[x - dx][y]++;
+      if (b == 4 && field[x + dx][y] < maxWater)
+        field[x + dx][y]++;
+    }
+  };
+
+  // Pass 2: Mass Conserving Flow (Backwards)
+  // "densityFlow" determines the rate of flow in this pass (originally k=2)
+  auto flow = [&](int x, int y, auto dx) {
+    if ((field[x][y] > 0) && (field[x][y] < 99)) { // Match original condition
+      int u = field[x][y - 1];
+      int d = field[x][y + 1];
+      int l = field[x - dx][y];
+      int r = field[x + dx][y];
+
+      int q = d;
+      int b = 2; // Default (down)
+
+      if (l < q) {
+        q = l;
+        b = 3;
+      }
+      if (r < q) {
+        q = r;
+        b = 4;
+      }
+      if (u < q) {
+        q = u;
+        b = 1;
+      }
+
+      // Move water - use available amount to prevent sticking. A transfer
+      // stops one short of WALL_VALUE, which only matters when densityFlow is
+      // raised above the default.
+      int flowAmt = (field[x][y] >= densityFlow) ? densityFlow : field[x][y];
+      uint8_t *target = b == 1   ? &field[x][y - 1]
+                        : b == 2 ? &field[x][y + 1]
+                        : b == 3 ? &field[x - dx][y]
+                                 : &field[x + dx][y];
+      if (flowAmt > 0 && *target < maxWater) {
+        int room = WALL_VALUE - 1 - *target;
+        flowAmt = flowAmt < room ? flowAmt : room;
+        *target += flowAmt;
+        field[x][y] -= flowAmt;
+      }
+    }
+  };
+
+  SweepOrder order = (SweepOrder)simParams.sweepOrder;
+  bool mirror = false;
+  if (order != SweepOrder::Reference) {
+    mirror = sweepOdd;
+    sweepOdd = !sweepOdd;
+  }
+  if (order == SweepOrder::Serpentine) {
+    sweepBands(true, mirror, decay);
+    sweepBands(false, mirror, flow);
+  } else {
+    sweepColumns(true, mirror, decay);
+    sweepColumns(false, mirror, flow);
+  }
+}
+
+// =============================================================================
+// Jacobi (double-buffered) kernel
+// =============================================================================
+//
+// Each phase below updates rows [lo, hi] of column x. The driver runs the
+// direction phases over awake tiles and the gather phases over live tiles.
+
+/// Flow direction codes, matching `b` in the reference kernel. DIR_STUCK
+/// marks a water cell whose lowest neighbour is saturated: in pass 1 it still
+/// loses its unit of density, as in the reference.
+enum : uint8_t {
+  DIR_NONE = 0,
+  DIR_UP = 1,
+  DIR_DOWN = 2,
+  DIR_LEFT = 3,
+  DIR_RIGHT = 4,
+  DIR_STUCK = 5
+};
+
+/// Copy the cells the kernels never update (outermost rows and columns)
+static void copyBorder(const Grid &src, const Grid &dst) {
+  memcpy(dst[0], src[0], screenHeight);
+  memcpy(dst[screenWidth - 1], src[screenWidth - 1], screenHeight);
+  for (int x = 1; x < screenWidth - 1; x++) {
+    dst[x][0] = src[x][0];
+    dst[x][screenHeight - 1] = src[x][screenHeight - 1];
+  }
+}
+
+#if SLIME_SIMD
+// Vector versions of the four phases, 16 cells of a column at a time. Columns
+// are contiguous in y, so up/down neighbours are unaligned loads at y -/+ 1
+// and left/right neighbours are loads from the adjacent columns. Masks are
+// 0x00/0xFF per lane.
+
+static_assert(MIN_FIELD_HEIGHT - 2 >= 16, "column too short for SIMD kernel");
+
+/**
+ * @brief Call body(y, mask) for 16-row vectors covering rows [lo, hi] of
+ * columns `height` cells long
+ *
+ * Ranges of 16 rows or more end with a vector that overlaps its predecessor;
+ * recomputing those cells is harmless because no phase reads what it
+ * writes. Shorter ranges use a single vector whose lanes outside the range
+ * are masked off (mask is null for full vectors).
+ */
+template <typename Fn>
+static inline void forEachVector(int height, int lo, int hi, Fn &&body) {
+  if (hi - lo + 1 >= 16) {
+    for (int y = lo;; y += 16) {
+      if (y > hi - 15)
+        y = hi - 15;
+      body(y, (const u8x16 *)nullptr);
+      if (y == hi - 15)
+        break;
+    }
+  } else {
+    static const uint8_t lane[16] = {0, 1, 2,  3,  4,  5,  6,  7,
+                                     8, 9, 10, 11, 12, 13, 14, 15};
+    // Lowest start row for a vector that stays inside the column
+    int last = height - 1 - 16;
+    int y = lo < last ? lo : last;
+    u8x16 idx = vload(lane);
+    u8x16 mask = vandnot(vandnot(vsplat(0xFF), vlt(idx, vsplat(lo - y))),
+                         vlt(vsplat(hi - y), idx));
+    body(y, &mask);
+  }
+}
+
+/// Store v, leaving lanes outside *mask untouched
+static inline void vstoreRows(uint8_t *p, u8x16 v, const u8x16 *mask) {
+  vstore(p, mask ? vselect(*mask, v, vload(p)) : v);
+}
+
+/// Pick the lowest of four neighbours in the given tie order. q holds the
+/// minimum so far and b the direction code of that minimum.
+#define TAKE_LOWER(n, code)                                                    \
+  do {                                                                         \
+    u8x16 lower = vlt(n, q);                                                   \
+    b = vselect(lower, vsplat(code), b);                                       \
+    q = vmin(n, q);                                                            \
+  } while (0)
+
+static void chooseDecay(const Grid &src, const Grid &dirs, int x, int lo,
+                        int hi) {
+  const u8x16 zero = vsplat(0), wall = vsplat(WALL_VALUE),
+              drain = vsplat(DRAIN_VALUE), max = vsplat(simParams.maxWater);
+  const uint8_t *c = src[x], *l = src[x - 1], *r = src[x + 1];
+  uint8_t *dir = dirs[x];
+  forEachVector(src.stride, lo, hi, [&](int y, const u8x16 *mask) {
+    u8x16 v = vload(c + y), d = vload(c + y + 1);
+    u8x16 q = d, b = vsplat(DIR_DOWN);
+    TAKE_LOWER(vload(c + y - 1), DIR_UP);
+    TAKE_LOWER(vload(l + y), DIR_LEFT);
+    TAKE_LOWER(vload(r + y), DIR_RIGHT);
+    b = vselect(vlt(q, max), b, vsplat(DIR_STUCK));
+    u8x16 flows = vandnot(vlt(v, wall), vor(veq(v, zero), veq(d, drain)));
+    vstoreRows(dir + y, vand(flows, b), mask);
+  });
+}
+
+static void gatherDecay(const Grid &src, const Grid &dst, const Grid &dirs,
+                        int x, int lo, int hi) {
+  const u8x16 one = vsplat(1), none = vsplat(DIR_NONE),
+              wall = vsplat(WALL_VALUE), drain = vsplat(DRAIN_VALUE),
+              max = vsplat(simParams.maxWater);
+  const uint8_t *c = src[x];
+  const uint8_t *dir = dirs[x], *dl = dirs[x - 1], *dr = dirs[x + 1];
+  uint8_t *out = dst[x];
+  forEachVector(src.stride, lo, hi, [&](int y, const u8x16 *mask) {
+    u8x16 v = vload(c + y);
+    u8x16 drained = veq(vload(c + y + 1), drain);
+    u8x16 solid = vor(veq(v, wall),
+                      vandnot(vandnot(vsplat(0xFF), vlt(v, wall)), drained));
+    // Each matching mask lane is 0xFF (-1), so subtracting counts inflows
+    u8x16 w = vsub(v, vandnot(one, veq(vload(dir + y), none)));
+    w = vandnot(w, drained);
+    w = vsub(w, veq(vload(dir + y - 1), vsplat(DIR_DOWN)));
+    w = vsub(w, veq(vload(dir + y + 1), vsplat(DIR_UP)));
+    w = vsub(w, veq(vload(dl + y), vsplat(DIR_RIGHT)));
+    w = vsub(w, veq(vload(dr + y), vsplat(DIR_LEFT)));
+    vstoreRows(out + y, vselect(solid, v, vmin(w, max)), mask);
+  });
+}
+
+static void chooseFlow(const Grid &src, const Grid &dirs, int x, int lo,
+                       int hi) {
+  const u8x16 zero = vsplat(0), wall = vsplat(WALL_VALUE),
+              max = vsplat(simParams.maxWater);
+  const uint8_t *c = src[x], *l = src[x - 1], *r = src[x + 1];
+  uint8_t *dir = dirs[x];
+  forEachVector(src.stride, lo, hi, [&](int y, const u8x16 *mask) {
+    u8x16 v = vload(c + y);
+    u8x16 q = vload(c + y + 1), b = vsplat(DIR_DOWN);
+    TAKE_LOWER(vload(l + y), DIR_LEFT);
+    TAKE_LOWER(vload(r + y), DIR_RIGHT);
+    TAKE_LOWER(vload(c + y - 1), DIR_UP);
+    u8x16 flows = vandnot(vand(vlt(v, wall), vlt(q, max)), veq(v, zero));
+    vstoreRows(dir + y, vand(flows, b), mask);
+  });
+}
+
+static void gatherFlow(const Grid &src, const Grid &dst, const Grid &dirs,
+                       int x, int lo, int hi) {
+  const u8x16 none = vsplat(DIR_NONE), wall = vsplat(WALL_VALUE),
+              max = vsplat(simParams.maxWater),
+              amount = vsplat(simParams.densityFlow);
+  const uint8_t *c = src[x], *l = src[x - 1], *r = src[x + 1];
+  const uint8_t *dir = dirs[x], *dl = dirs[x - 1], *dr = dirs[x + 1];
+  uint8_t *out = dst[x];
+  forEachVector(src.stride, lo, hi, [&](int y, const u8x16 *mask) {
+    u8x16 v = vload(c + y);
+    u8x16 w = vsub(v, vandnot(vmin(v, amount), veq(vload(dir + y), none)));
+    w = vadd(w, vand(veq(vload(dir + y - 1), vsplat(DIR_DOWN)),
+                     vmin(vload(c + y - 1), amount)));
+    w = vadd(w, vand(veq(vload(dir + y + 1), vsplat(DIR_UP)),
+                     vmin(vload(c + y + 1), amount)));
+    w = vadd(w, vand(veq(vload(dl + y), vsplat(DIR_RIGHT)),
+                     vmin(vload(l + y), amount)));
+    w = vadd(w, vand(veq(vload(dr + y), vsplat(DIR_LEFT)),
+                     vmin(vload(r + y), amount)));
+    vstoreRows(out + y, vselect(vlt(v, wall), vmin(w, max), v), mask);
+  });
+}
+
+#undef TAKE_LOWER
+
+#else
+
+/**
+ * @brief Pass 1 direction phase
+ *
+ * Each water cell picks its lowest neighbour (down, then up, left, right on
+ * ties, as in the reference). A saturated target means no transfer. The loops
+ * here and below are branch-free so the compiler can vectorize them along y.
+ */
+static void chooseDecay(const Grid &src, const Grid &dirs, int x, int lo,
+                        int hi) {
+  const uint8_t *c = src[x], *l = src[x - 1], *r = src[x + 1];
+  uint8_t *dir = dirs[x];
+  const int max = simParams.maxWater;
+  for (int y = lo; y <= hi; y++) {
+    int q = c[y + 1];
+    int b = DIR_DOWN;
+    b = c[y - 1] < q ? DIR_UP : b;
+    q = c[y - 1] < q ? c[y - 1] : q;
+    b = l[y] < q ? DIR_LEFT : b;
+    q = l[y] < q ? l[y] : q;
+    b = r[y] < q ? DIR_RIGHT : b;
+    q = r[y] < q ? r[y] : q;
+    b = q < max ? b : DIR_STUCK;
+    bool flows = c[y] > 0 && c[y] < WALL_VALUE && c[y + 1] != DRAIN_VALUE;
+    dir[y] = flows ? b : DIR_NONE;
+  }
+}
+
+/**
+ * @brief Pass 1 gather phase
+ *
+ * Every flowing cell loses one unit, whether or not its target accepted it,
+ * and gains one unit per neighbour that chose it. Simultaneous inflow is
+ * clamped at maxWater.
+ */
+static void gatherDecay(const Grid &src, const Grid &dst, const Grid &dirs,
+                        int x, int lo, int hi) {
+  const uint8_t *c = src[x];
+  const uint8_t *dir = dirs[x], *dl = dirs[x - 1], *dr = dirs[x + 1];
+  uint8_t *out = dst[x];
+  const int max = simParams.maxWater;
+  for (int y = lo; y <= hi; y++) {
+    int v = c[y];
+    bool drained = c[y + 1] == DRAIN_VALUE;
+    bool wall = v == WALL_VALUE || (v > WALL_VALUE && !drained);
+    int in = (dir[y - 1] == DIR_DOWN) + (dir[y + 1] == DIR_UP) +
+             (dl[y] == DIR_RIGHT) + (dr[y] == DIR_LEFT);
+    int w = (drained ? 0 : v - (dir[y] != DIR_NONE)) + in;
+    out[y] = wall ? v : (w > max ? max : w);
+  }
+}
+
+/**
+ * @brief Pass 2 direction phase
+ *
+ * Same as pass 1 but with the reference pass 2 tie order (down, left, right,
+ * up), and a saturated target means the cell keeps its water.
+ */
+static void chooseFlow(const Grid &src, const Grid &dirs, int x, int lo,
+                       int hi) {
+  const uint8_t *c = src[x], *l = src[x - 1], *r = src[x + 1];
+  uint8_t *dir = dirs[x];
+  const int max = simParams.maxWater;
+  for (int y = lo; y <= hi; y++) {
+    int q = c[y + 1];
+    int b = DIR_DOWN;
+    b = l[y] < q ? DIR_LEFT : b;
+    q = l[y] < q ? l[y] : q;
+    b = r[y] < q ? DIR_RIGHT : b;
+    q = r[y] < q ? r[y] : q;
+    b = c[y - 1] < q ? DIR_UP : b;
+    q = c[y - 1] < q ? c[y - 1] : q;
+    bool flows = c[y] > 0 && c[y] < WALL_VALUE && q < max;
+    dir[y] = flows ? b : DIR_NONE;
+  }
+}
+
+/// Amount a water cell of density v sends in pass 2
+static inline int flowAmount(int v, int amount) {
+  return v >= amount ? amount : v;
+}
+
+/**
+ * @brief Pass 2 gather phase
+ *
+ * A cell that chose a target sends up to densityFlow units and receives the
+ * same from each neighbour that chose it, clamped at maxWater.
+ */
+static void gatherFlow(const Grid &src, const Grid &dst, const Grid &dirs,
+                       int x, int lo, int hi) {
+  const uint8_t *c = src[x], *l = src[x - 1], *r = src[x + 1];
+  const uint8_t *dir = dirs[x], *dl = dirs[x - 1], *dr = dirs[x + 1];
+  uint8_t *out = dst[x];
+  const int max = simParams.maxWater, amount = simParams.densityFlow;
+  for (int y = lo; y <= hi; y++) {
+    int v = c[y];
+    int w = v - (dir[y] != DIR_NONE ? flowAmount(v, amount) : 0);
+    w += dir[y - 1] == DIR_DOWN ? flowAmount(c[y - 1], amount) : 0;
+    w += dir[y + 1] == DIR_UP ? flowAmount(c[y + 1], amount) : 0;
+    w += dl[y] == DIR_RIGHT ? flowAmount(l[y], amount) : 0;
+    w += dr[y] == DIR_LEFT ? flowAmount(r[y], amount) : 0;
+    out[y] = v >= WALL_VALUE ? v : (w > max ? max : w);
+  }
+}
+
+#endif
+
+// Each Jacobi phase as a band job. A phase only writes its own columns and
+// reads its neighbours' columns from the previous phase, so the barrier at the
+// end of each parallelFor() is all the synchronisation the bands need.
+
+static void chooseDecayBand(int band, int bands) {
+  int x0, x1;
+  bandColumns(band, bands, &x0, &x1);
+  for (int x = x0; x <= x1; x++)
+    forEachRun(tile_live[x / TILE_SIZE], true, [&](int lo, int hi) {
+      chooseDecay(field, flow_dir, x, lo, hi);
+    });
+}
+
+static void gatherDecayBand(int band, int bands) {
+  int x0, x1;
+  bandColumns(band, bands, &x0, &x1);
+  for (int x = x0; x <= x1; x++) {
+    const uint8_t *live = tile_live[x / TILE_SIZE];
+    forEachRun(live, true, [&](int lo, int hi) {
+      gatherDecay(field, field_next, flow_dir, x, lo, hi);
+    });
+    forEachRun(live, false, [&](int lo, int hi) {
+      memcpy(&field_next[x][lo], &field[x][lo], hi - lo + 1);
+    });
+  }
+}
+
+static void chooseFlowBand(int band, int bands) {
+  int x0, x1;
+  bandColumns(band, bands, &x0, &x1);
+  for (int x = x0; x <= x1; x++)
+    forEachRun(tile_live[x / TILE_SIZE], true, [&](int lo, int hi) {
+      chooseFlow(field_next, flow_dir, x, lo, hi);
+    });
+}
+
+static void gatherFlowBand(int band, int bands) {
+  int x0, x1;
+  bandColumns(band, bands, &x0, &x1);
+  for (int x = x0; x <= x1; x++)
+    forEachRun(tile_awake[x / TILE_SIZE], true, [&](int lo, int hi) {
+      gatherFlow(field_next, field, flow_dir, x, lo, hi);
+    });
+}
+
+/**
+ * @brief Double-buffered kernel: field -> field_next -> field
+ *
+ * Only awake tiles can change, but a sleeping cell may still move within a
+ * step (a unit of water on a wall rises in pass 1 and falls back in pass 2),
+ * and awake cells next to it see that. So everything up to the last phase
+ * runs over the live tiles, the awake ones and a tile of margin, which is
+ * more than the three cells an awake cell's result reads across; the last
+ * phase writes the awake tiles only. Cells at the outer edge of the margin
+ * gather from directions that were not computed this step, but nothing
+ * awake reads them. Pass 1 copies non-live tiles into field_next.
+ */
+static void simulateJacobi() {
+  parallelFor(chooseDecayBand);
+  parallelFor(gatherDecayBand);
+  copyBorder(field, field_next);
+  parallelFor(chooseFlowBand);
+  parallelFor(gatherFlowBand);
+}
+
+// =============================================================================
+// Temporally tiled Jacobi kernel
+// =============================================================================
+//
+// One Jacobi step reads cells up to STEP_RADIUS away, so k steps of a block
+// can be computed from the block plus a halo of k * STEP_RADIUS cells, without
+// any other block. Each band copies a block and its halo into its own small
+// buffers, runs k steps there while they stay in cache, and writes the block
+// back to field_next. The halo is recomputed by every block that needs it:
+// extra arithmetic in exchange for reading the field once per k steps.
+//
+// Each step shrinks the part of the buffer that is still correct by
+// STEP_RADIUS on every side that has a halo (sides at the field border hold
+// border cells, which never change), and after k steps exactly the block is
+// left. Blocks whose surroundings are all asleep cannot change in k steps
+// and are skipped. The result is identical to k calls of simulate().
+
+/// Edge length of a block's buffers: a block and its widest halo
+constexpr int BLOCK_SPAN =
+    TEMPORAL_BLOCK + 2 * STEP_RADIUS * MAX_TEMPORAL_STEPS;
+constexpr int BLOCK_CELLS = BLOCK_SPAN * BLOCK_SPAN;
+
+/// Steps per block in the current simulateBlocks() call
+static int block_steps;
+
+/// Rows or columns [lo, hi] of a buffer n cells long that a phase updates,
+/// `margin` cells in from each side that has a halo (open) and one cell in
+/// from each side at the field border
+static inline void phaseRange(int margin, bool openLo, bool openHi, int n,
+                              int *lo, int *hi) {
+  *lo = openLo ? margin : 1;
+  *hi = openHi ? n - 1 - margin : n - 2;
+}
+
+/// True if any tile within the block's halo is awake
+static bool blockAwake(int tx0, int ty0, int tx1, int ty1, int haloTiles) {
+  tx0 = tx0 - haloTiles < 0 ? 0 : tx0 - haloTiles;
+  ty0 = ty0 - haloTiles < 0 ? 0 : ty0 - haloTiles;
+  tx1 = tx1 + haloTiles >= tilesX ? tilesX - 1 : tx1 + haloTiles;
+  ty1 = ty1 + haloTiles >= tilesY ? tilesY - 1 : ty1 + haloTiles;
+  for (int tx = tx0; tx <= tx1; tx++)
+    for (int ty = ty0; ty <= ty1; ty++)
+      if (tile_awake[tx][ty])
+        return true;
+  return false;
+}
+
+/**
+ * @brief Run block_steps steps of the block at (bx, by) in its buffers
+ *
+ * Leaves the result in field_next and sets tile_changed (changed in the last
+ * step) and tile_live (differs from field) for the block's tiles.
+ */
+static void runBlock(int bx, int by, uint8_t *scratch) {
+  const int k = block_steps, halo = STEP_RADIUS * k;
+  const Grid a{scratch, BLOCK_SPAN}, b{scratch + BLOCK_CELLS, BLOCK_SPAN},
+      dirs{scratch + 2 * BLOCK_CELLS, BLOCK_SPAN};
+
+  int cx0 = bx * TEMPORAL_BLOCK, cy0 = by * TEMPORAL_BLOCK;
+  int cx1 = cx0 + TEMPORAL_BLOCK > screenWidth ? screenWidth - 1
+                                               : cx0 + TEMPORAL_BLOCK - 1;
+  int cy1 = cy0 + TEMPORAL_BLOCK > screenHeight ? screenHeight - 1
+                                                : cy0 + TEMPORAL_BLOCK - 1;
+  int tx0 = cx0 / TILE_SIZE, ty0 = cy0 / TILE_SIZE;
+  int tx1 = cx1 / TILE_SIZE, ty1 = cy1 / TILE_SIZE;
+  if (!blockAwake(tx0, ty0, tx1, ty1, (halo + TILE_SIZE - 1) / TILE_SIZE)) {
+    for (int tx = tx0; tx <= tx1; tx++)
+      for (int ty = ty0; ty <= ty1; ty++)
+        tile_changed[tx][ty] = tile_live[tx][ty] = 0;
+    return;
+  }
+
+  // The block and its halo, clipped to the screen, in buffer coordinates
+  int x0 = cx0 - halo < 0 ? 0 : cx0 - halo;
+  int y0 = cy0 - halo < 0 ? 0 : cy0 - halo;
+  int x1 = cx1 + halo >= screenWidth ? screenWidth - 1 : cx1 + halo;
+  int y1 = cy1 + halo >= screenHeight ? screenHeight - 1 : cy1 + halo;
+  int w = x1 - x0 + 1, h = y1 - y0 + 1;
+  bool openL = x0 > 0, openR = x1 < screenWidth - 1;
+  bool openT = y0 > 0, openB = y1 < screenHeight - 1;
+  for (int x = 0; x < w; x++)
+    memcpy(a[x], &field[x0 + x][y0], h);
+
+  // Cells on the field border never change and never flow; the second buffer
+  // needs them too, and directions left over from other blocks must not show
+  // there. Elsewhere both buffers are written before they are read.
+  if (!openL) {
+    memcpy(b[0], a[0], h);
+    memset(dirs[0], DIR_NONE, h);
+  }
+  if (!openR) {
+    memcpy(b[w - 1], a[w - 1], h);
+    memset(dirs[w - 1], DIR_NONE, h);
+  }
+  for (int x = 0; x < w; x++) {
+    if (!openT) {
+      b[x][0] = a[x][0];
+      dirs[x][0] = DIR_NONE;
+    }
+    if (!openB) {
+      b[x][h - 1] = a[x][h - 1];
+      dirs[x][h - 1] = DIR_NONE;
+    }
+  }
+
+  int bw = cx1 - cx0 + 1, bh = cy1 - cy0 + 1;
+  for (int step = 0; step < k; step++) {
+    if (step == k - 1) {
+      // Keep the second to last state to tell which tiles changed last
+      for (int x = 0; x < bw; x++)
+        memcpy(&field_next[cx0 + x][cy0], &a[cx0 - x0 + x][cy0 - y0], bh);
+    }
+    int m = STEP_RADIUS * step, xlo, xhi, ylo, yhi;
+    phaseRange(m + 1, openL, openR, w, &xlo, &xhi);
+    phaseRange(m + 1, openT, openB, h, &ylo, &yhi);
+    for (int x = xlo; x <= xhi; x++)
+      chooseDecay(a, dirs, x, ylo, yhi);
+    phaseRange(m + 2, openL, openR, w, &xlo, &xhi);
+    phaseRange(m + 2, openT, openB, h, &ylo, &yhi);
+    for (int x = xlo; x <= xhi; x++)
+      gatherDecay(a, b, dirs, x, ylo, yhi);
+    phaseRange(m + 3, openL, openR, w, &xlo, &xhi);
+    phaseRange(m + 3, openT, openB, h, &ylo, &yhi);
+    for (int x = xlo; x <= xhi; x++)
+      chooseFlow(b, dirs, x, ylo, yhi);
+    phaseRange(m + 4, openL, openR, w, &xlo, &xhi);
+    phaseRange(m + 4, openT, openB, h, &ylo, &yhi);
+    for (int x = xlo; x <= xhi; x++)
+      gatherFlow(b, a, dirs, x, ylo, yhi);
+  }
+
+  for (int tx = tx0; tx <= tx1; tx++) {
+    for (int ty = ty0; ty <= ty1; ty++) {
+      int left = tx * TILE_SIZE, right = tx == tx1 ? cx1 : left + TILE_SIZE - 1;
+      int lo = ty * TILE_SIZE;
+      int n = (ty == ty1 ? cy1 : lo + TILE_SIZE - 1) - lo + 1;
+      bool changed = false, differs = false;
+      for (int x = left; x <= right; x++) {
+        const uint8_t *result = &a[x - x0][lo - y0];
+        changed = changed || memcmp(&field_next[x][lo], result, n);
+        differs = differs || memcmp(&field[x][lo], result, n);
+        memcpy(&field_next[x][lo], result, n);
+      }
+      tile_changed[tx][ty] = changed;
+      tile_live[tx][ty] = differs;
+    }
+  }
+}
+
+static void blockBand(int band, int bands) {
+  int blocksX = (screenWidth + TEMPORAL_BLOCK - 1) / TEMPORAL_BLOCK;
+  int blocksY = (screenHeight + TEMPORAL_BLOCK - 1) / TEMPORAL_BLOCK;
+  uint8_t *scratch = block_scratch + (unsigned long)band * 3 * BLOCK_CELLS;
+  for (int bx = blocksX * band / bands; bx < blocksX * (band + 1) / bands; bx++)
+    for (int by = 0; by < blocksY; by++)
+      runBlock(bx, by, scratch);
+}
+
+/// Copy the tiles that differ (tile_live) from field_next into field
+static void copyBackBand(int band, int bands) {
+  for (int tx = tilesX * band / bands; tx < tilesX * (band + 1) / bands; tx++) {
+    int left = tx * TILE_SIZE, right = left + TILE_SIZE;
+    right = right > screenWidth ? screenWidth : right;
+    forEachRun(tile_live[tx], true, [&](int lo, int hi) {
+      for (int x = left; x < right; x++)
+        memcpy(&field[x][lo], &field_next[x][lo], hi - lo + 1);
+    });
+  }
+}
+
+/**
+ * @brief Advance k steps block by block; false if the buffers could not be
+ * allocated (nothing was done)
+ */
+static bool simulateBlocks(int k) {
+  int bands = getThreadCount();
+  if (scratch_bands < bands) {
+    block_scratch = arenaAlloc((unsigned long)bands * 3 * BLOCK_CELLS);
+    scratch_bands = block_scratch ? bands : 0;
+    if (!block_scratch)
+      return false;
+  }
+  if (!sleepTiles)
+    wakeAll();
+  block_steps = k;
+  parallelFor(blockBand);
+  parallelFor(copyBackBand);
+  if (!sleepTiles) {
+    markAllDirty();
+    memset(tile_unsaved.cells, UNSAVED_ALL, tilesX * tilesY);
+    changed_tiles = tilesX * tilesY;
+    return true;
+  }
+  for (int i = 0; i < tilesX * tilesY; i++) {
+    tile_dirty.cells[i] |= tile_live.cells[i];
+    tile_unsaved.cells[i] |= tile_live.cells[i] * UNSAVED_ALL;
+  }
+  changed_tiles = countTiles(tile_changed);
+  updateAwake();
+  return true;
+}
+
+void simulateSteps(int n) {
+  while (n > 0) {
+    int k = n < temporalSteps ? n : temporalSteps;
+    if (simMode == SimMode::Jacobi && k > 1 && simulateBlocks(k)) {
+      n -= k;
+    } else {
+      simulate();
+      n--;
+    }
+  }
+}
+
+void skipSteps(int n) {
+  if (simMode == SimMode::InPlace &&
+      (SweepOrder)simParams.sweepOrder != SweepOrder::Reference && (n & 1))
+    sweepOdd = !sweepOdd;
+}
+
+void simulate() {
+  prepareTiles();
+  if (simMode == SimMode::Jacobi)
+    simulateJacobi();
+  else
+    simulateInPlace();
+  settleTiles();
+}
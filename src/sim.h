@@ -0,0 +1,222 @@
+/**
+ * @file sim.h
+ * @brief Water flow kernels
+ *
+ * The simulation advances the field with two flow passes per step. Two
+ * update schemes are available:
+ *
+ * - InPlace: the original DOS algorithm. Each pass sweeps the field and
+ *   modifies it as it goes, so every cell sees the cells updated before it.
+ *   This is the reference behaviour.
+ * - Jacobi: each pass reads one buffer and writes another. Every cell first
+ *   picks the neighbour it flows into, then gathers what its neighbours sent
+ *   it, so all cells of a pass can be computed independently (in any order,
+ *   in SIMD lanes or on separate threads, see threads.h).
+ *
+ * The field is divided into TILE_SIZE x TILE_SIZE tiles that can sleep. A
+ * tile falls asleep after a step in which none of its cells changed and is
+ * skipped by the Jacobi kernel until it is woken, either because a
+ * neighbouring tile changed or because an edit touched it (see wakeRect()).
+ * The in-place kernel visits every tile, as skipping one would change its
+ * results, and does not track them either: every tile counts as changed.
+ * Code that writes to `field` directly must wake the cells it touches.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include "platform.h"
+
+/// Flow kernel update scheme
+enum class SimMode {
+  InPlace = 0, ///< Sequential in-place sweeps (reference)
+  Jacobi = 1   ///< Order-independent double-buffered passes
+};
+
+/// Active update scheme, InPlace by default
+extern SimMode simMode;
+
+/// Order in which the in-place kernel visits cells (the Jacobi kernel does
+/// not depend on order)
+enum class SweepOrder {
+  Reference = 0,   ///< Pass 1 left to right, pass 2 right to left, always
+  Alternating = 1, ///< Every other step mirrored left to right
+  Serpentine = 2   ///< Alternating, and mirrored every other band of rows
+};
+
+/// Parameters that can be changed at run time (set_param())
+enum class Param {
+  DensityFlow = 0,      ///< Mass a cell sends per pass 2 flow
+  MaxWater = 1,         ///< Density above which a cell accepts no inflow
+  RainProbability = 2,  ///< 1 in N chance per column per step
+  WaterSpawnAmount = 3, ///< Density of a rain drop
+  SweepOrder = 4,       ///< In-place sweep schedule (a SweepOrder)
+  Count
+};
+
+/// Tunable flow and rain parameters of the current world
+struct SimParams {
+  int densityFlow = DENSITY_FLOW;
+  int maxWater = MAX_WATER;
+  int rainProbability = RAIN_PROBABILITY;
+  int waterSpawnAmount = WATER_SPAWN_AMOUNT;
+  int sweepOrder = (int)SweepOrder::Reference;
+};
+
+extern SimParams simParams;
+
+/// True if the next Alternating or Serpentine in-place step is mirrored.
+/// Flips once per such step (never under Reference) and starts false on
+/// init() and n(). Saved with the game state (see snapshot.h).
+extern bool sweepOdd;
+
+/// Allocate the kernel buffers for the current screen size and wake every
+/// tile; false if out of memory. Called by init().
+bool initSim();
+
+/// Advance the water simulation by one step using the active scheme
+void simulate();
+
+/// Account for n steps that would leave the field as it is (see is_idle()
+/// in game.h) without running them: what carries over from step to step,
+/// such as the sweep parity, moves on as if they had run
+void skipSteps(int n);
+
+/**
+ * @brief Advance the water simulation by n steps
+ *
+ * In Jacobi mode with temporalSteps above 1 the steps are run temporally
+ * tiled (see TEMPORAL_BLOCK). Only for steps with nothing else touching the
+ * field in between; the result is the same as n calls of simulate().
+ */
+void simulateSteps(int n);
+
+// =============================================================================
+// Sleeping Tiles
+// =============================================================================
+
+constexpr int TILE_SIZE = 16; ///< Tile edge length in cells
+
+/// Tile columns and rows covering the screen, set by initSim()
+extern int tilesX, tilesY;
+
+/// When false every tile is simulated every step and nothing is compared (on
+/// by default; the in-place kernel always runs as if it were off)
+extern bool sleepTiles;
+
+/// Wake every tile, e.g. after the whole field was rewritten
+void wakeAll();
+
+/// Wake the tiles containing or bordering the cell rectangle (x1, y1)-(x2, y2)
+/// (inclusive, any corner order, clipped to the screen)
+void wakeRect(int x1, int y1, int x2, int y2);
+
+/// Number of awake tiles: those the Jacobi kernel will simulate in the next
+/// step (the in-place kernel simulates every tile)
+int countAwakeTiles();
+
+/// Number of tiles whose cells changed in the last step (all of them with
+/// sleeping tiles off or in place, as nothing is compared then). 0 once the
+/// water has come to rest.
+int countChangedTiles();
+
+// =============================================================================
+// Temporal Tiling
+// =============================================================================
+//
+// Stepping the whole field k times streams it through the cache k times. The
+// temporally tiled Jacobi kernel instead takes the field one TEMPORAL_BLOCK
+// square at a time, together with the halo of cells that k steps of the block
+// depend on, and runs all k steps on it while it sits in cache. Halos
+// overlap, so their cells are computed more than once (about a quarter more
+// work at the largest depth): this pays off on fields too large for the
+// cache when memory bandwidth, not arithmetic, limits the plain kernel, as
+// when several threads share it.
+
+constexpr int TEMPORAL_BLOCK = 256;   ///< Block edge length (whole tiles)
+constexpr int MAX_TEMPORAL_STEPS = 8; ///< Most steps run per block
+constexpr int STEP_RADIUS = 4;        ///< Cells a Jacobi step reads across
+
+/// Steps simulateSteps() runs per block; 1 (the default) turns tiling off
+extern int temporalSteps;
+
+// =============================================================================
+// Dirty Tiles
+// =============================================================================
+//
+// Tiles whose pixels in video_buffer are out of date or have been drawn over
+// since the last presented frame. Steps mark the tiles that changed (or
+// everything, with sleeping tiles off), wakeRect()/wakeAll() mark edits and
+// putpixel() marks UI drawing, so render() repaints and the host uploads
+// only those tiles.
+
+constexpr int MAX_DIRTY_RECTS = 64; ///< Rectangles per frame before merging
+
+/// Mark the tile containing pixel (x, y) (ignored if off screen)
+void markDirty(int x, int y);
+
+/// Mark the tiles covering pixels (x1, y1)-(x2, y2) (inclusive, x1 <= x2,
+/// y1 <= y2, clipped to the screen)
+void markDirtyRect(int x1, int y1, int x2, int y2);
+
+/// Mark every tile
+void markAllDirty();
+
+/**
+ * @brief Convert the dirty tiles into pixel rectangles and clear them
+ *
+ * Writes up to MAX_DIRTY_RECTS rectangles as {x, y, width, height} into
+ * rects and returns how many. Horizontal runs of dirty tiles become one
+ * rectangle, and equal runs in consecutive rows are merged; if that is still
+ * too many, the bounding box of all dirty tiles is returned instead.
+ */
+int takeDirtyRects(int *rects);
+
+// =============================================================================
+// Unsaved Tiles
+// =============================================================================
+//
+// Tiles whose cells may differ from the last saved snapshot, so that an
+// autosave can write just those (see save_tile() in snapshot.h), or from
+// the last frame of the rewind history (see push_history() in history.h).
+// Set by the same change detection and edits that mark tiles dirty, and
+// kept, one bit per user, until that user has saved the tile.
+
+constexpr uint8_t UNSAVED_SNAPSHOT = 1; ///< Autosave
+constexpr uint8_t UNSAVED_HISTORY = 2;  ///< Rewind history
+constexpr uint8_t UNSAVED_ALL = UNSAVED_SNAPSHOT | UNSAVED_HISTORY;
+
+/// True if tile (tx, ty) changed since `user` last saved it
+bool tileUnsaved(int tx, int ty, uint8_t user);
+
+/// Record tile (tx, ty) as saved by `user`
+void markTileSaved(int tx, int ty, uint8_t user);
+
+/// Record every tile as saved by `user`, e.g. after a full snapshot was
+/// loaded
+void markAllSaved(uint8_t user);
+
+// =============================================================================
+// World State
+// =============================================================================
+
+/// Everything sim.cpp keeps for one world (see context.cpp)
+struct SimState {
+  SimMode simMode = SimMode::InPlace;
+  SimParams params;
+  int temporalSteps = 1;
+  bool sweepOdd = false;
+  bool sleepTiles = true;
+  int tilesX = 0, tilesY = 0;
+  Grid tile_awake, tile_live, tile_changed, tile_dirty, tile_unsaved;
+  int changedTiles = 0;
+  Grid field_prev, flow_dir, field_next;
+  uint8_t *blockScratch = nullptr;
+  int scratchBands = 0;
+};
+
+/// Copy the live kernel state out (to switch worlds) and back in
+void saveSimState(SimState *state);
+void loadSimState(const SimState &state);
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * @file simd.h
+ * @brief 16-lane unsigned byte vector helpers for the flow kernels
+ *
+ * Maps a small set of operations onto WebAssembly SIMD128 (`-msimd128`) or,
+ * for native builds, SSE2. vandnot(a, b) is a & ~b; comparisons return
+ * all-ones lanes where true. SLIME_SIMD is defined to 1 when either is
+ * available; define SLIME_NO_SIMD to force the scalar kernels.
+ */
+
+#ifndef SIMD_H
+#define SIMD_H
+
+#include "platform.h"
+
+#if !defined(SLIME_NO_SIMD) && defined(__wasm_simd128__)
+#define SLIME_SIMD 1
+#include <wasm_simd128.h>
+
+typedef v128_t u8x16;
+
+inline u8x16 vload(const uint8_t *p) { return wasm_v128_load(p); }
+inline void vstore(uint8_t *p, u8x16 v) { wasm_v128_store(p, v); }
+inline u8x16 vsplat(uint8_t v) { return wasm_i8x16_splat((int8_t)v); }
+inline u8x16 vmin(u8x16 a, u8x16 b) { return wasm_u8x16_min(a, b); }
+inline u8x16 vlt(u8x16 a, u8x16 b) { return wasm_u8x16_lt(a, b); }
+inline u8x16 veq(u8x16 a, u8x16 b) { return wasm_i8x16_eq(a, b); }
+inline u8x16 vand(u8x16 a, u8x16 b) { return wasm_v128_and(a, b); }
+inline u8x16 vor(u8x16 a, u8x16 b) { return wasm_v128_or(a, b); }
+inline u8x16 vandnot(u8x16 a, u8x16 b) { return wasm_v128_andnot(a, b); }
+inline u8x16 vadd(u8x16 a, u8x16 b) { return wasm_i8x16_add(a, b); }
+inline u8x16 vsub(u8x16 a, u8x16 b) { return wasm_i8x16_sub(a, b); }
+inline u8x16 vsubs(u8x16 a, u8x16 b) { return wasm_u8x16_sub_sat(a, b); }
+inline u8x16 vselect(u8x16 mask, u8x16 a, u8x16 b) {
+  return wasm_v128_bitselect(a, b, mask);
+}
+
+#elif !defined(SLIME_NO_SIMD) && defined(__SSE2__)
+#define SLIME_SIMD 1
+#include <emmintrin.h>
+
+typedef __m128i u8x16;
+
+inline u8x16 vload(const uint8_t *p) {
+  return _mm_loadu_si128((const __m128i *)p);
+}
+inline void vstore(uint8_t *p, u8x16 v) { _mm_storeu_si128((__m128i *)p, v); }
+inline u8x16 vsplat(uint8_t v) { return _mm_set1_epi8((char)v); }
+inline u8x16 vmin(u8x16 a, u8x16 b) { return _mm_min_epu8(a, b); }
+inline u8x16 veq(u8x16 a, u8x16 b) { return _mm_cmpeq_epi8(a, b); }
+inline u8x16 vlt(u8x16 a, u8x16 b) {
+  // SSE2 has no unsigned compare: a < b exactly when max(a, b) != a
+  return _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(a, b), a),
+                       _mm_set1_epi8(-1));
+}
+inline u8x16 vand(u8x16 a, u8x16 b) { return _mm_and_si128(a, b); }
+inline u8x16 vor(u8x16 a, u8x16 b) { return _mm_or_si128(a, b); }
+inline u8x16 vandnot(u8x16 a, u8x16 b) { return _mm_andnot_si128(b, a); }
+inline u8x16 vadd(u8x16 a, u8x16 b) { return _mm_add_epi8(a, b); }
+inline u8x16 vsub(u8x16 a, u8x16 b) { return _mm_sub_epi8(a, b); }
+inline u8x16 vsubs(u8x16 a, u8x16 b) { return _mm_subs_epu8(a, b); }
+inline u8x16 vselect(u8x16 mask, u8x16 a, u8x16 b) {
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+#else
+#define SLIME_SIMD 0
+#endif
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * @file slime.h
+ * @brief Embedding API: many simulation worlds in one process, one live at
+ * a time
+ *
+ * Each SimContext holds a complete world with its own field, walls, tiles,
+ * sidebar, pointers, random sequence, input queue and buffers. Every
+ * function takes the world it acts on. Natively this is packaged as
+ * libslime.a (`make lib`); the WASM builds export the same functions
+ * alongside the single-world API the page uses.
+ *
+ * The engine itself is single-instance: it computes on globals, and a
+ * SimContext is a saved copy of them that a call swaps in before it runs
+ * (see context.cpp). Worlds are independent in what they hold, not in how
+ * they run: only one is live at a time, and switching costs some tens of
+ * kilobytes of copying whenever a call addresses a different world than
+ * the previous one, so step a world in batches (slime_step()) rather than
+ * one step per call.
+ *
+ * None of this is thread-safe. All calls, for every world, must come from
+ * one thread, or be serialized by the host; two worlds cannot step at the
+ * same time. To run worlds in parallel, use one process per core as
+ * tools/sweep.cpp does. slime_set_thread_count() spreads each step of the
+ * live world over threads.
+ *
+ * Coordinates are screen pixels: the field is x in [0, width) and the
+ * sidebar follows it on the right.
+ */
+
+#ifndef SLIME_H
+#define SLIME_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct SimContext SimContext;
+
+/// Create a world with a width x height field (0, 0 for the default 300x200),
+/// seeded with 0. Returns NULL if it does not fit in memory.
+SimContext *slime_create(int width, int height);
+
+/// Destroy a world created by slime_create() and free its buffers
+void slime_destroy(SimContext *ctx);
+
+/// Field size in cells
+int slime_field_width(SimContext *ctx);
+int slime_field_height(SimContext *ctx);
+
+/// Screen (field plus sidebar) size in pixels
+int slime_screen_width(SimContext *ctx);
+int slime_screen_height(SimContext *ctx);
+
+/// Restart the world's random sequence from seed
+void slime_seed(SimContext *ctx, uint32_t seed);
+
+/// Reset to an empty basin with border walls
+void slime_reset(SimContext *ctx);
+
+/// Turn rain on or off
+void slime_set_rain(SimContext *ctx, int enabled);
+
+/// Pause (1) or resume (0) the water simulation
+void slime_set_paused(SimContext *ctx, int paused);
+
+/// Flow kernel: 0 = in-place reference, 1 = Jacobi
+void slime_set_sim_mode(SimContext *ctx, int mode);
+
+/// Set a tunable parameter: 0 = density flow, 1 = max water, 2 = rain
+/// probability (1 in N), 3 = water spawn amount, 4 = sweep order (0
+/// reference, 1 alternating, 2 serpentine). Values are clamped.
+void slime_set_param(SimContext *ctx, int param, int value);
+
+/// Current value of a tunable parameter
+int slime_get_param(SimContext *ctx, int param);
+
+/// Jacobi steps run per block in slime_step() (1 = off, up to 8); temporal
+/// tiling pays off on fields much larger than the CPU cache
+void slime_set_temporal_steps(SimContext *ctx, int k);
+
+/// Skip sleeping tiles (1, the default) or simulate every tile (0)
+void slime_set_sleep_tiles(SimContext *ctx, int enabled);
+
+/// Speed multiplier used by slime_advance()
+void slime_set_speed(SimContext *ctx, double speed);
+
+/// Draw a wall line between two cells
+void slime_draw_wall(SimContext *ctx, int x1, int y1, int x2, int y2);
+
+/// Set every non-wall cell in the rectangle (inclusive) to a water density
+/// (0 clears)
+void slime_fill_water(SimContext *ctx, int x1, int y1, int x2, int y2,
+                      int density);
+
+/// Cell value at (x, y): 0 empty, 1-98 water density, 99 wall; -1 off screen
+int slime_cell(SimContext *ctx, int x, int y);
+
+/// Queue a pointer sample (0 = none, 1 = left, 2 = right) for pointer slot
+/// 0..9; it is applied at the start of the next slime_advance() or step
+/// with input. Returns 0 if the input queue is full.
+int slime_pointer(SimContext *ctx, int pointer, int x, int y, int buttons);
+
+/// Run n steps without processing input; returns the number of steps run
+int slime_step(SimContext *ctx, int n);
+
+/// Process queued input, then run the steps elapsed_ms covers at the
+/// world's speed; returns the number of steps run
+int slime_advance(SimContext *ctx, double elapsed_ms);
+
+/// Run up to `steps` steps without processing input, stopping once
+/// time_budget_ms of wall time is used (0: no limit); returns the number of
+/// steps done
+int slime_fast_forward(SimContext *ctx, int steps, double time_budget_ms);
+
+/// Take a full snapshot of the world (field and game state, see
+/// snapshot.h): points data at it and returns its size. The bytes stay
+/// valid until the next snapshot call on this world.
+int slime_save_snapshot(SimContext *ctx, const uint8_t **data);
+
+/// Restore a snapshot taken from a world of the same field size; returns 0
+/// if it is malformed or the sizes differ
+int slime_load_snapshot(SimContext *ctx, const uint8_t *data, int size);
+
+/// 1 if stepping would not change the world (water at rest, no rain, no
+/// held brush, or paused), so stepping can stop until the next input
+int slime_is_idle(SimContext *ctx);
+
+/// Bring the world's frame up to date
+void slime_render(SimContext *ctx);
+
+/// The world's RGBA frame (screen width x height, row-major), valid until
+/// the world is destroyed
+const uint8_t *slime_frame(SimContext *ctx);
+
+/// Number of worker threads each step is split over (shared by all worlds)
+void slime_set_thread_count(int n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
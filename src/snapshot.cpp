@@ -0,0 +1,426 @@
+/**
+ * @file snapshot.cpp
+ * @brief Snapshot records: encoding, decoding and the exported API
+ *
+ * See snapshot.h for the record layout.
+ */
+
+#include "snapshot.h"
+#include "game.h"
+#include "replay.h"
+#include "rng.h"
+#include "sim.h"
+#include "walls.h"
+
+/// Record header: magic, kind, field width and height
+constexpr int HEADER_SIZE = 9;
+
+/// Largest game state block
+constexpr int GAME_STATE_SIZE = 37 + 4 * (int)Param::Count;
+
+/// Pointer block of a checkpoint
+constexpr int POINTERS_SIZE = 1 + 19 * MAX_POINTERS;
+
+/// Offsets of the flags and the speed in a record with a game state
+constexpr int FLAGS_OFFSET = HEADER_SIZE + 2;
+constexpr int SPEED_OFFSET = HEADER_SIZE + 8;
+
+/// Game state flag bits
+constexpr int FLAG_RAIN = 1;
+constexpr int FLAG_PAUSED = 2;
+constexpr int FLAG_SWEEP_ODD = 4;
+constexpr int FLAG_NO_SLEEP = 8;
+
+/// Runs shorter than this are written as single cells
+constexpr int MIN_RUN = 3;
+
+static uint8_t *snapshot_buf;
+static int snapshot_capacity;
+
+void saveSnapshotState(SnapshotState *state) {
+  state->buffer = snapshot_buf;
+  state->capacity = snapshot_capacity;
+}
+
+void loadSnapshotState(const SnapshotState &state) {
+  snapshot_buf = state.buffer;
+  snapshot_capacity = state.capacity;
+}
+
+bool allocateSnapshot() {
+  // Cells never take more than a byte each
+  unsigned long size = HEADER_SIZE + GAME_STATE_SIZE + POINTERS_SIZE +
+                       (unsigned long)fieldWidth * fieldHeight;
+  snapshot_buf = arenaAlloc(size);
+  snapshot_capacity = snapshot_buf ? (int)size : 0;
+  return snapshot_buf != nullptr;
+}
+
+// =============================================================================
+// Byte Streams
+// =============================================================================
+
+/// Little-endian writer; the buffer is always large enough (see
+/// allocateSnapshot())
+struct Writer {
+  uint8_t *p;
+
+  void u8(int v) { *p++ = (uint8_t)v; }
+  void u16(int v) {
+    u8(v);
+    u8(v >> 8);
+  }
+  void u32(uint32_t v) {
+    u16((int)(v & 0xFFFF));
+    u16((int)(v >> 16));
+  }
+  void f64(double v) {
+    memcpy(p, &v, 8);
+    p += 8;
+  }
+};
+
+/// Little-endian reader; reading past the end yields zeros and clears ok
+struct Reader {
+  const uint8_t *p, *end;
+  bool ok = true;
+
+  int u8() {
+    if (p >= end) {
+      ok = false;
+      return 0;
+    }
+    return *p++;
+  }
+  int u16() {
+    int lo = u8();
+    return lo | u8() << 8;
+  }
+  uint32_t u32() {
+    uint32_t lo = (uint32_t)u16();
+    return lo | (uint32_t)u16() << 16;
+  }
+  double f64() {
+    double v = 0;
+    if (end - p < 8)
+      ok = false;
+    else
+      memcpy(&v, p, 8);
+    p += 8;
+    return v;
+  }
+};
+
+// =============================================================================
+// Cells
+// =============================================================================
+
+/// Run-length code the cells of columns [x0, x1], rows [y0, y1]
+static void encodeCells(Writer &w, int x0, int x1, int y0, int y1) {
+  int value = -1, run = 0;
+  auto flush = [&]() {
+    if (run >= MIN_RUN) {
+      w.u8(0x80 | value);
+      for (unsigned count = run - MIN_RUN; ; count >>= 7) {
+        w.u8((count & 0x7F) | (count > 0x7F ? 0x80 : 0));
+        if (count <= 0x7F)
+          break;
+      }
+    } else {
+      for (int i = 0; i < run; i++)
+        w.u8(value);
+    }
+  };
+  for (int x = x0; x <= x1; x++) {
+    const uint8_t *column = field[x];
+    for (int y = y0; y <= y1; y++) {
+      if (column[y] == value) {
+        run++;
+        continue;
+      }
+      flush();
+      value = column[y];
+      run = 1;
+    }
+  }
+  flush();
+}
+
+/// Decode cells into columns [x0, x1], rows [y0, y1]; false if the stream is
+/// malformed or holds a value above DRAIN_VALUE
+static bool decodeCells(Reader &r, int x0, int x1, int y0, int y1) {
+  int x = x0, y = y0;
+  while (x <= x1) {
+    int token = r.u8();
+    int value = token & 0x7F;
+    unsigned run = 1;
+    if (token & 0x80) {
+      unsigned count = 0;
+      for (int shift = 0; shift < 28; shift += 7) {
+        int b = r.u8();
+        count |= (unsigned)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+          break;
+      }
+      run = count + MIN_RUN;
+    }
+    if (!r.ok || value > DRAIN_VALUE)
+      return false;
+    for (; run > 0 && x <= x1; run--) {
+      putCell(x, y, value);
+      if (++y > y1) {
+        y = y0;
+        x++;
+      }
+    }
+    if (run > 0)
+      return false;
+  }
+  return true;
+}
+
+// =============================================================================
+// Game State
+// =============================================================================
+
+static void writeHeader(Writer &w, char kind) {
+  w.u8('S');
+  w.u8('L');
+  w.u8('M');
+  w.u8('1');
+  w.u8(kind);
+  w.u16(fieldWidth);
+  w.u16(fieldHeight);
+}
+
+static void writeGameState(Writer &w) {
+  RngState rng;
+  saveRandomState(&rng);
+  w.u8((int)game.eraser);
+  w.u8(game.drawmode);
+  w.u8((game.rainmode ? FLAG_RAIN : 0) | (game.paused ? FLAG_PAUSED : 0) |
+       (sweepOdd ? FLAG_SWEEP_ODD : 0) | (sleepTiles ? 0 : FLAG_NO_SLEEP));
+  w.u8((int)simMode);
+  w.u32((uint32_t)game.frames);
+  w.f64(game.speed);
+  w.u32(rng.seed);
+  for (uint32_t word : rng.state)
+    w.u32(word);
+  w.u8((int)Param::Count);
+  for (int p = 0; p < (int)Param::Count; p++)
+    w.u32((uint32_t)get_param(p));
+}
+
+static bool readGameState(Reader &r) {
+  int eraser = r.u8();
+  int drawmode = r.u8();
+  int flags = r.u8();
+  int mode = r.u8();
+  uint32_t frames = r.u32();
+  double speed = r.f64();
+  RngState rng;
+  rng.seed = r.u32();
+  for (uint32_t &word : rng.state)
+    word = r.u32();
+  int params = r.u8();
+  int values[(int)Param::Count];
+  for (int p = 0; p < params; p++) {
+    int v = (int)r.u32();
+    if (p < (int)Param::Count)
+      values[p] = v;
+  }
+  if (!r.ok || eraser > (int)EraserMode::Water || drawmode < 1 ||
+      drawmode > 2)
+    return false;
+
+  game.eraser = (EraserMode)eraser;
+  game.drawmode = drawmode;
+  game.rainmode = flags & FLAG_RAIN;
+  game.paused = flags & FLAG_PAUSED;
+  game.frames = (int)frames;
+  set_speed(speed);
+  set_sim_mode(mode);
+  sweepOdd = flags & FLAG_SWEEP_ODD;
+  // set_sleep_tiles() wakes every tile, so only if it differs
+  bool sleep = !(flags & FLAG_NO_SLEEP);
+  if (sleepTiles != sleep)
+    set_sleep_tiles(sleep);
+  loadRandomState(rng);
+  // set_param() wakes every tile, so only for values that differ
+  for (int p = 0; p < params && p < (int)Param::Count; p++)
+    if (get_param(p) != values[p])
+      set_param(p, values[p]);
+  syncToolButtons();
+  return true;
+}
+
+/// Every pointer's buttons and stroke, for checkpoints
+static void writePointers(Writer &w) {
+  w.u8(MAX_POINTERS);
+  for (const Pointer &p : pointers) {
+    const TMouse &m = p.mouse;
+    const InputState &in = p.input;
+    w.u32((uint32_t)m.x);
+    w.u32((uint32_t)m.y);
+    w.u8((m.leftDown ? 1 : 0) | (m.rightDown ? 2 : 0) |
+         (m.oldLeftDown ? 4 : 0) | (m.oldRightDown ? 8 : 0) |
+         (in.hasLeft ? 16 : 0) | (in.mayDraw ? 32 : 0));
+    w.u8((int)in.eraser);
+    w.u8(in.drawmode);
+    w.u32((uint32_t)in.x1);
+    w.u32((uint32_t)in.y1);
+  }
+}
+
+static bool readPointers(Reader &r) {
+  if (r.u8() != MAX_POINTERS)
+    return false;
+  for (Pointer &p : pointers) {
+    TMouse &m = p.mouse;
+    InputState &in = p.input;
+    m.x = (int)r.u32();
+    m.y = (int)r.u32();
+    int flags = r.u8();
+    int eraser = r.u8();
+    in.drawmode = r.u8();
+    in.x1 = (int)r.u32();
+    in.y1 = (int)r.u32();
+    m.leftDown = flags & 1;
+    m.rightDown = (flags >> 1) & 1;
+    m.oldLeftDown = (flags >> 2) & 1;
+    m.oldRightDown = (flags >> 3) & 1;
+    in.hasLeft = flags & 16;
+    in.mayDraw = flags & 32;
+    in.eraser = (EraserMode)(eraser <= (int)EraserMode::Water ? eraser : 0);
+  }
+  return r.ok;
+}
+
+// =============================================================================
+// Records
+// =============================================================================
+
+/// Last field column and row of tile (tx, ty)
+static void tileCells(int tx, int ty, int *x1, int *y1) {
+  *x1 = tx * TILE_SIZE + TILE_SIZE - 1;
+  *y1 = ty * TILE_SIZE + TILE_SIZE - 1;
+  if (*x1 >= fieldWidth)
+    *x1 = fieldWidth - 1;
+  if (*y1 >= fieldHeight)
+    *y1 = fieldHeight - 1;
+}
+
+bool loadSnapshot(const uint8_t *data, int size) {
+  Reader r{data, data + (size > 0 ? size : 0)};
+  bool magic = r.u8() == 'S' && r.u8() == 'L' && r.u8() == 'M' &&
+               r.u8() == '1';
+  int kind = r.u8();
+  int width = r.u16(), height = r.u16();
+  if (!r.ok || !magic || width != fieldWidth || height != fieldHeight)
+    return false;
+
+  if (kind == 'G')
+    return readGameState(r);
+  if (kind == 'F' || kind == 'C') {
+    if (!readGameState(r) || (kind == 'C' && !readPointers(r)))
+      return false;
+    bool ok = decodeCells(r, 0, fieldWidth - 1, 0, fieldHeight - 1);
+    addBorderWalls();
+    wakeAll();
+    if (ok)
+      markAllSaved(UNSAVED_SNAPSHOT);
+    return ok;
+  }
+  if (kind == 'T') {
+    int tx = r.u16(), ty = r.u16();
+    int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+    if (!r.ok || x0 >= fieldWidth || y0 >= fieldHeight)
+      return false;
+    int x1, y1;
+    tileCells(tx, ty, &x1, &y1);
+    bool ok = decodeCells(r, x0, x1, y0, y1);
+    addBorderWalls();
+    wakeRect(x0, y0, x1, y1);
+    if (ok)
+      markTileSaved(tx, ty, UNSAVED_SNAPSHOT);
+    return ok;
+  }
+  return false;
+}
+
+int writeCheckpoint(uint8_t *data) {
+  Writer w{data};
+  writeHeader(w, 'C');
+  writeGameState(w);
+  writePointers(w);
+  encodeCells(w, 0, fieldWidth - 1, 0, fieldHeight - 1);
+  return (int)(w.p - data);
+}
+
+bool checkpointMatches(const uint8_t *data, int size) {
+  if (size > snapshot_capacity || size < SPEED_OFFSET + 8)
+    return false;
+  int own = writeCheckpoint(snapshot_buf);
+  // The speed only decides how many steps a frame runs, and the log has the
+  // steps themselves; sleeping tiles only decide how fast they run
+  memcpy(snapshot_buf + SPEED_OFFSET, data + SPEED_OFFSET, 8);
+  snapshot_buf[FLAGS_OFFSET] &= ~FLAG_NO_SLEEP;
+  snapshot_buf[FLAGS_OFFSET] |= data[FLAGS_OFFSET] & FLAG_NO_SLEEP;
+  return own == size && !memcmp(snapshot_buf, data, size);
+}
+
+extern "C" {
+
+int save_snapshot() {
+  Writer w{snapshot_buf};
+  writeHeader(w, 'F');
+  writeGameState(w);
+  encodeCells(w, 0, fieldWidth - 1, 0, fieldHeight - 1);
+  markAllSaved(UNSAVED_SNAPSHOT);
+  return (int)(w.p - snapshot_buf);
+}
+
+int save_game_state() {
+  Writer w{snapshot_buf};
+  writeHeader(w, 'G');
+  writeGameState(w);
+  return (int)(w.p - snapshot_buf);
+}
+
+int save_tile(int index) {
+  if (index < 0 || index >= tilesX * tilesY)
+    return 0;
+  int tx = index % tilesX, ty = index / tilesX;
+  if (!tileUnsaved(tx, ty, UNSAVED_SNAPSHOT))
+    return 0;
+  markTileSaved(tx, ty, UNSAVED_SNAPSHOT);
+  int x0 = tx * TILE_SIZE, y0 = ty * TILE_SIZE;
+  if (x0 >= fieldWidth)
+    return 0; // sidebar
+  int x1, y1;
+  tileCells(tx, ty, &x1, &y1);
+
+  Writer w{snapshot_buf};
+  writeHeader(w, 'T');
+  w.u16(tx);
+  w.u16(ty);
+  encodeCells(w, x0, x1, y0, y1);
+  return (int)(w.p - snapshot_buf);
+}
+
+int save_checkpoint() {
+  recordCheckpoint();
+  return writeCheckpoint(snapshot_buf);
+}
+
+int get_tile_count() { return tilesX * tilesY; }
+
+int load_snapshot(int size) {
+  return size <= snapshot_capacity && loadSnapshot(snapshot_buf, size);
+}
+
+uint8_t *get_snapshot_buffer() { return snapshot_buf; }
+
+int get_snapshot_capacity() { return snapshot_capacity; }
+
+} // extern "C"
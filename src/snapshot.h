@@ -0,0 +1,128 @@
+/**
+ * @file snapshot.h
+ * @brief Saving and restoring a world as compact byte records
+ *
+ * A snapshot holds the field (water, walls and drains) together with the
+ * game state that decides how it evolves: tool, draw mode, rain, pause,
+ * speed, the tunable parameters, the flow kernel and its sweep parity
+ * (sweepOdd in sim.h), sleeping tiles, the step counter and the random
+ * generator. Restoring one and stepping on gives the same run as the world
+ * it was taken from. Which tiles are asleep is not saved: restoring the
+ * field wakes every tile, and waking tiles never changes a step. Nor are
+ * the temporal steps and thread count, which only change how fast a step
+ * runs.
+ *
+ * Four kinds of record share one layout, so a host can store them as they
+ * come and hand each back to load_snapshot():
+ *
+ * - 'F' full: the game state and every field cell
+ * - 'G' game state only
+ * - 'T' one tile: the cells of one TILE_SIZE square
+ * - 'C' checkpoint: a full record that also holds every pointer's buttons
+ *   and stroke, so that an input log (see replay.h) can go on from it
+ *
+ * A full snapshot of a large field takes a while to encode and store, so an
+ * autosave writes one full record once and from then on only 'G' and the
+ * 'T' records of tiles that changed since they were last saved (see
+ * tileUnsaved() in sim.h), a few per frame. Loading the full record, then
+ * the latest 'G' and 'T' records in any order, rebuilds the world. The
+ * pointers are left out of these, so a restored world never starts with a
+ * button held.
+ *
+ * Layout (little-endian):
+ *
+ *     "SLM1"  magic and version
+ *     u8      kind ('F', 'G' or 'T')
+ *     u16     field width, u16 field height (must match the loading world)
+ *     'F', 'G', 'C': game state
+ *       u8 eraser, u8 draw mode, u8 flags (1 rain, 2 paused, 4 next sweep
+ *       mirrored, 8 sleeping tiles off), u8 sim mode,
+ *       u32 step counter, f64 speed, u32 seed, u32 x 4 generator state,
+ *       u8 parameter count n, u32 x n parameters (in Param order)
+ *     'C': pointers
+ *       u8 count (MAX_POINTERS), then per pointer: u32 x, u32 y, u8 flags
+ *       (1 left, 2 right, 4 old left, 8 old right, 16 stroke started,
+ *       32 may draw), u8 eraser, u8 draw mode, u32 x, u32 y of the stroke
+ *     'F', 'C': cells of columns 0 .. width-1, each top to bottom
+ *     'T': u16 tile column, u16 tile row, then the tile's cells, column by
+ *          column (clipped to the field)
+ *
+ * Cells are run-length coded: a byte below 0x80 is one cell of that value,
+ * and 0x80 | v followed by a LEB128 count c is a run of c + 3 cells of
+ * value v. Columns are coded one after the other, so an empty 300x200 field
+ * takes about 1.5 KB (its border walls break every column), and no field
+ * codes to more than one byte per cell.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "platform.h"
+
+/// Allocate the snapshot buffer for the current field size; false if out of
+/// memory. Called by init().
+bool allocateSnapshot();
+
+/**
+ * @brief Restore a record of any kind from data
+ *
+ * Cells are decoded straight into the field in one pass. Returns false if
+ * the record is malformed or was taken from a field of another size; a
+ * malformed cell stream may leave the cells before the error loaded.
+ */
+bool loadSnapshot(const uint8_t *data, int size);
+
+/// Write a checkpoint of the current world to data, which must hold
+/// get_snapshot_capacity() bytes; returns its size in bytes
+int writeCheckpoint(uint8_t *data);
+
+/// True if the checkpoint record data equals one taken of the current world
+/// now, apart from the speed and sleeping tiles. Overwrites the snapshot
+/// buffer.
+bool checkpointMatches(const uint8_t *data, int size);
+
+/// Snapshot buffer of one world (see context.cpp)
+struct SnapshotState {
+  uint8_t *buffer = nullptr;
+  int capacity = 0;
+};
+
+/// Copy the live snapshot state out (to switch worlds) and back in
+void saveSnapshotState(SnapshotState *state);
+void loadSnapshotState(const SnapshotState &state);
+
+// =============================================================================
+// Exported API (called from JavaScript)
+// =============================================================================
+//
+// Records are built in, and loaded from, one buffer in linear memory
+// (get_snapshot_buffer()), large enough for a checkpoint of the field.
+
+extern "C" {
+/// Write a full snapshot to the buffer and mark every tile saved; returns
+/// its size in bytes
+int save_snapshot();
+
+/// Write a game state record to the buffer; returns its size in bytes
+int save_game_state();
+
+/// Write the record of tile `index` (tile row * tilesX + tile column) to the
+/// buffer and mark it saved; returns its size, or 0 if the tile has not
+/// changed since it was last saved (or lies outside the field)
+int save_tile(int index);
+
+/// Write a checkpoint to the buffer; returns its size in bytes. While
+/// recording, the input log continues from it (see replay.h).
+int save_checkpoint();
+
+/// Number of tiles, for iterating save_tile()
+int get_tile_count();
+
+/// Load the record of the given size from the buffer; 1 on success
+int load_snapshot(int size);
+
+uint8_t *get_snapshot_buffer();
+int get_snapshot_capacity();
+}
+
+#endif
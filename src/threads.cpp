@@ -0,0 +1,129 @@
+/**
+ * @file threads.cpp
+ * @brief Worker pool implementation
+ *
+ * Each worker waits on its own generation counter in worker_go[]. To run a
+ * job the calling thread publishes the job, bumps the counters of the
+ * workers taking part and wakes them, runs band 0 itself and spins on
+ * pool_pending until the workers are done. Workers block with
+ * memory.atomic.wait32 in the browser and futex natively.
+ */
+
+#include "threads.h"
+
+#if defined(SLIME_THREADS)
+
+#if defined(__wasm__)
+
+static void threadWait(int *addr, int value) {
+  __builtin_wasm_memory_atomic_wait32(addr, value, -1);
+}
+
+static void threadWake(int *addr) {
+  __builtin_wasm_memory_atomic_notify(addr, 1);
+}
+
+/// Shadow stacks for the workers; the page points each worker's
+/// __stack_pointer at workerStackTop(id) before calling worker_main()
+alignas(16) static uint8_t worker_stacks[MAX_THREADS][WORKER_STACK_SIZE];
+
+uint8_t *workerStackTop(int id) {
+  if (id < 1 || id >= MAX_THREADS)
+    return nullptr;
+  return worker_stacks[id] + WORKER_STACK_SIZE;
+}
+
+#else
+
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static void threadWait(int *addr, int value) {
+  syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, nullptr, nullptr, 0);
+}
+
+static void threadWake(int *addr) {
+  syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+static int threads_started = 1; ///< Native workers started so far, plus main
+
+static void *nativeWorker(void *arg) {
+  workerMain((int)(intptr_t)arg);
+  return nullptr;
+}
+
+#endif
+
+static int thread_count = 1;
+
+// Current job, written by the calling thread before workers are woken
+static BandJob pool_job;
+static int pool_bands;
+
+/// Workers still running the current job
+static int pool_pending;
+
+/// Per-worker generation counter, bumped once per job the worker takes part in
+static int worker_go[MAX_THREADS];
+
+void setThreadCount(int n) {
+  if (n < 1)
+    n = 1;
+  if (n > MAX_THREADS)
+    n = MAX_THREADS;
+#if !defined(__wasm__)
+  for (; threads_started < n; threads_started++) {
+    pthread_t thread;
+    pthread_create(&thread, nullptr, nativeWorker,
+                   (void *)(intptr_t)threads_started);
+    pthread_detach(thread);
+  }
+#endif
+  thread_count = n;
+}
+
+int getThreadCount() { return thread_count; }
+
+void parallelFor(BandJob job) {
+  int bands = thread_count;
+  if (bands <= 1) {
+    job(0, 1);
+    return;
+  }
+  pool_job = job;
+  pool_bands = bands;
+  __atomic_store_n(&pool_pending, bands - 1, __ATOMIC_SEQ_CST);
+  for (int id = 1; id < bands; id++) {
+    __atomic_fetch_add(&worker_go[id], 1, __ATOMIC_SEQ_CST);
+    threadWake(&worker_go[id]);
+  }
+  job(0, bands);
+  while (__atomic_load_n(&pool_pending, __ATOMIC_ACQUIRE) != 0) {
+  }
+}
+
+void workerMain(int id) {
+  // Counters start at 0, so a job published before this worker got here is
+  // still picked up
+  int seen = 0;
+  for (;;) {
+    int go;
+    while ((go = __atomic_load_n(&worker_go[id], __ATOMIC_ACQUIRE)) == seen)
+      threadWait(&worker_go[id], seen);
+    seen = go;
+    pool_job(id, pool_bands);
+    __atomic_fetch_sub(&pool_pending, 1, __ATOMIC_RELEASE);
+  }
+}
+
+#else
+
+void setThreadCount(int n) {}
+int getThreadCount() { return 1; }
+void parallelFor(BandJob job) { job(0, 1); }
+void workerMain(int id) {}
+
+#endif
@@ -0,0 +1,51 @@
+/**
+ * @file threads.h
+ * @brief Minimal worker pool for splitting simulation phases into bands
+ *
+ * Built with SLIME_THREADS, work is spread over a fixed pool of workers:
+ * pthreads in native builds, Web Workers sharing the module's memory in the
+ * threaded WASM build (the simulation worker, docs/sim.js, starts them and
+ * each calls worker_main()).
+ * Without SLIME_THREADS every job simply runs on the calling thread.
+ *
+ * The calling thread always takes band 0 and then spins until the other
+ * bands are done, so that the pool also works on a browser main thread,
+ * which is not allowed to block.
+ */
+
+#ifndef THREADS_H
+#define THREADS_H
+
+#include "platform.h"
+
+constexpr int MAX_THREADS = 16; ///< Upper bound on bands per job
+
+/// A unit of parallel work: process part `band` of `bands` equal parts
+typedef void (*BandJob)(int band, int bands);
+
+/**
+ * @brief Set the number of bands (threads) jobs are split into
+ *
+ * Clamped to [1, MAX_THREADS], and to 1 when built without SLIME_THREADS.
+ * Native builds start any missing worker threads here; in the browser the
+ * page must have started workers 1..n-1 beforehand.
+ */
+void setThreadCount(int n);
+
+/// Current number of bands
+int getThreadCount();
+
+/// Run job over all bands and return once every band has finished
+void parallelFor(BandJob job);
+
+/// Worker loop for worker `id` (1..MAX_THREADS-1); never returns
+void workerMain(int id);
+
+#if defined(SLIME_THREADS) && defined(__wasm__)
+constexpr int WORKER_STACK_SIZE = 64 * 1024; ///< Shadow stack per worker
+
+/// Top of the shadow stack reserved for worker `id`
+uint8_t *workerStackTop(int id);
+#endif
+
+#endif
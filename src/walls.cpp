@@ -0,0 +1,64 @@
+/**
+ * @file walls.cpp
+ * @brief Wall bitplane and its projection into the density plane
+ */
+
+#include "walls.h"
+#include "game.h"
+
+WallPlane walls;
+
+bool allocateWalls() {
+  walls.stride = (screenHeight + 31) / 32;
+  walls.words = (uint32_t *)arenaAlloc((unsigned long)screenWidth *
+                                       walls.stride * sizeof(uint32_t));
+  return walls.words != nullptr;
+}
+
+void setWall(int x, int y) {
+  walls[x][y >> 5] |= 1u << (y & 31);
+  field[x][y] = WALL_VALUE;
+}
+
+void removeWall(int x, int y) {
+  walls[x][y >> 5] &= ~(1u << (y & 31));
+  field[x][y] = 0;
+}
+
+void putCell(int x, int y, int v) {
+  if (v == WALL_VALUE) {
+    setWall(x, y);
+    return;
+  }
+  walls[x][y >> 5] &= ~(1u << (y & 31));
+  field[x][y] = v;
+}
+
+void addBorderWalls() {
+  for (int x = 0; x < fieldWidth; x++) {
+    setWall(x, 0);
+    setWall(x, fieldHeight - 1);
+  }
+  for (int y = 0; y < fieldHeight; y++) {
+    setWall(0, y);
+    setWall(fieldWidth - 1, y);
+  }
+}
+
+void clearWalls() {
+  forEachWall([](int x, int y) { field[x][y] = 0; });
+  memset(walls.words, 0,
+         (unsigned long)screenWidth * walls.stride * sizeof(uint32_t));
+}
+
+void restoreWalls() {
+  forEachWall([](int x, int y) { field[x][y] = WALL_VALUE; });
+}
+
+bool wallsMatchField() {
+  for (int x = 0; x < screenWidth; x++)
+    for (int y = 0; y < screenHeight; y++)
+      if (isWall(x, y) != (field[x][y] == WALL_VALUE))
+        return false;
+  return true;
+}
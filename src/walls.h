@@ -0,0 +1,76 @@
+/**
+ * @file walls.h
+ * @brief Packed wall bitplane
+ *
+ * Walls are stored one bit per cell, column-major in 32-bit words: bit
+ * y % 32 of word y / 32 of column x. This plane is the authoritative record
+ * of where walls are, and editing, clearing and queries work on it a word at
+ * a time.
+ *
+ * The flow kernels read only the density plane `field`, in which wall cells
+ * hold WALL_VALUE: a density no water cell reaches, so a wall is simply a
+ * neighbour that never accepts flow and the kernels need no extra loads or
+ * branches. The functions below keep that projection in step with the bits,
+ * so walls must only be changed through them. The kernels never change a
+ * wall: a drain empties the cell above it each step unless that is a wall.
+ */
+
+#ifndef WALLS_H
+#define WALLS_H
+
+#include "platform.h"
+
+/// Column-major wall bitset sized to the screen
+struct WallPlane {
+  uint32_t *words = nullptr;
+  int stride = 0; ///< 32-bit words per column
+  uint32_t *operator[](int x) const { return words + x * stride; }
+};
+
+/// Wall bits (defined in walls.cpp)
+extern WallPlane walls;
+
+/// Allocate an empty wall plane for the current screen size; false if out
+/// of memory. Called by init().
+bool allocateWalls();
+
+/// True if (x, y) is a wall (coordinates must be on screen)
+inline bool isWall(int x, int y) {
+  return (walls[x][y >> 5] >> (y & 31)) & 1;
+}
+
+/// Make (x, y) a wall, replacing any water there
+void setWall(int x, int y);
+
+/// Turn the wall at (x, y) into an empty cell
+void removeWall(int x, int y);
+
+/// Store any cell value at (x, y): a wall for WALL_VALUE, else water (or a
+/// drain) in place of whatever was there
+void putCell(int x, int y, int v);
+
+/// Wall in the edge rows and columns of the field
+void addBorderWalls();
+
+/// Remove every wall, leaving empty cells
+void clearWalls();
+
+/// Write WALL_VALUE back into `field` at every wall, after the density plane
+/// has been overwritten
+void restoreWalls();
+
+/// True if the bits and the WALL_VALUE cells of `field` mark the same cells
+bool wallsMatchField();
+
+/// Call visit(x, y) for every wall, scanning the bitset a word at a time
+template <typename Fn> void forEachWall(Fn &&visit) {
+  for (int x = 0; x < screenWidth; x++) {
+    const uint32_t *column = walls[x];
+    for (int i = 0; i < walls.stride; i++) {
+      for (uint32_t bits = column[i]; bits; bits &= bits - 1)
+        visit(x, i * 32 + __builtin_ctz(bits));
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * @file replay_seek.cpp
+ * @brief Check that seeking in a replay lands on the same world as playing
+ * it straight through
+ *
+ * Records a short session with the water brush and a change of sweep order
+ * in each kernel, with checkpoints at an odd number of steps apart so that
+ * they fall on both parities of the alternating sweep. Then replays it from
+ * the start, keeping the field at a few steps, and seeks back to each of
+ * them from the end. Built and run by `make check`; exits 1 on a
+ * difference.
+ */
+
+#include "game.h"
+#include "replay.h"
+#include "sim.h"
+#include "snapshot.h"
+
+#include <stdio.h>
+#include <vector>
+
+/// Frames in the session, and frames between checkpoints
+constexpr int FRAMES = 300;
+constexpr int CHECKPOINT_FRAMES = 25;
+
+/// Steps run per frame (odd, so the parity differs between checkpoints)
+constexpr int FRAME_STEPS = 3;
+
+static void appendChunk(std::vector<uint8_t> &log, int type,
+                        const uint8_t *data, int size) {
+  log.push_back((uint8_t)type);
+  for (int i = 0; i < 4; i++)
+    log.push_back((uint8_t)(size >> (8 * i)));
+  log.insert(log.end(), data, data + size);
+}
+
+/// Take what was logged since the last call as an 'I' chunk
+static void appendInput(std::vector<uint8_t> &log) {
+  int size = take_recording();
+  if (size > 0)
+    appendChunk(log, 'I', get_recording_buffer(), size);
+}
+
+/// Record a session in the given kernel
+static std::vector<uint8_t> record(SimMode mode) {
+  init(300, 200);
+  seed_random(12345);
+  set_sim_mode((int)mode);
+  set_param((int)Param::SweepOrder, (int)SweepOrder::Alternating);
+
+  std::vector<uint8_t> log = {'S', 'L', 'R', '1'};
+  start_recording();
+  appendChunk(log, 'C', get_snapshot_buffer(), save_checkpoint());
+  for (int frame = 1; frame <= FRAMES; frame++) {
+    // Pour water in a few places, a while each
+    if (frame % 60 == 1) {
+      set_mouse_pos(40 + frame % 200, 30 + frame % 100);
+      set_mouse_button(2);
+    } else if (frame % 60 == 20) {
+      set_mouse_button(0);
+    }
+    if (frame == FRAMES / 2)
+      set_param((int)Param::SweepOrder, (int)SweepOrder::Serpentine);
+    update();
+    step_many(FRAME_STEPS - 1);
+    if (frame % CHECKPOINT_FRAMES == 0) {
+      int size = save_checkpoint();
+      std::vector<uint8_t> checkpoint(get_snapshot_buffer(),
+                                      get_snapshot_buffer() + size);
+      appendInput(log);
+      appendChunk(log, 'C', checkpoint.data(), size);
+    }
+  }
+  stop_recording();
+  appendInput(log);
+  return log;
+}
+
+struct State {
+  int frames;
+  bool sweepOdd;
+  std::vector<uint8_t> cells;
+};
+
+static State state() {
+  return {game.frames, sweepOdd,
+          std::vector<uint8_t>(field.cells,
+                               field.cells + screenWidth * screenHeight)};
+}
+
+static bool same(const State &a, const State &b) {
+  return a.frames == b.frames && a.sweepOdd == b.sweepOdd &&
+         a.cells == b.cells;
+}
+
+static bool check(SimMode mode, const char *name) {
+  std::vector<uint8_t> log = record(mode);
+  uint8_t *buffer = replay_buffer((int)log.size());
+  if (buffer)
+    memcpy(buffer, log.data(), log.size());
+  if (!buffer || !open_replay((int)log.size())) {
+    printf("%s: the recorded log does not open\n", name);
+    return false;
+  }
+
+  // Step counters go on from earlier worlds
+  int start = game.frames, length = get_replay_length();
+  const int targets[] = {start + 1,   start + 74,
+                         start + 75,  start + 76,
+                         start + 200, start + FRAMES * FRAME_STEPS / 2,
+                         length - 1,  length};
+  std::vector<State> straight;
+  for (int step : targets) {
+    replay_to(step);
+    straight.push_back(state());
+  }
+  bool ok = get_replay_mismatches() == 0;
+  if (!ok)
+    printf("%s: %d of %d checkpoints differ from a straight replay\n", name,
+           get_replay_mismatches(), get_replay_checkpoints());
+
+  // From the end, so that every seek starts from a checkpoint
+  for (int i = (int)(sizeof targets / sizeof *targets) - 1; i >= 0; i--) {
+    replay_to(length);
+    seek_replay(targets[i]);
+    if (!same(state(), straight[i])) {
+      printf("%s: seeking to step %d differs from a straight replay\n", name,
+             targets[i]);
+      ok = false;
+    }
+  }
+  seek_replay(0);
+  replay_to(length);
+  if (get_replay_mismatches() != 0) {
+    printf("%s: checkpoints differ after a seek\n", name);
+    ok = false;
+  }
+  close_replay();
+  return ok;
+}
+
+int main() {
+  bool ok = check(SimMode::InPlace, "in-place");
+  ok = check(SimMode::Jacobi, "jacobi") && ok;
+  printf("replay_seek: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Check that slime_sweep reports the same results whatever the number of
+# worker processes: each combination must start from the same world, not
+# from what the worker ran before it. Run by `make check` with the path of
+# slime_sweep; exits 1 on a difference.
+
+sweep=${1:-build/slime_sweep}
+# An odd step limit, so that a sweep parity left over from the previous
+# combination would show
+args="-n 601 -p sweep_order=0:2 -p density_flow=1:2 -p max_water=60,97"
+
+# Everything but the last column, the step time
+$sweep -j 1 $args | sed 's/,[^,]*$//' > /tmp/sweep_jobs_1.$$ || exit 1
+$sweep -j 4 $args | sed 's/,[^,]*$//' > /tmp/sweep_jobs_4.$$ || exit 1
+if cmp -s /tmp/sweep_jobs_1.$$ /tmp/sweep_jobs_4.$$; then
+  echo "sweep_jobs: ok"
+  status=0
+else
+  echo "sweep_jobs: -j 1 and -j 4 report different results"
+  diff /tmp/sweep_jobs_1.$$ /tmp/sweep_jobs_4.$$
+  echo "sweep_jobs: FAILED"
+  status=1
+fi
+rm -f /tmp/sweep_jobs_1.$$ /tmp/sweep_jobs_4.$$
+exit $status
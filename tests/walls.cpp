@@ -0,0 +1,67 @@
+/**
+ * @file walls.cpp
+ * @brief Check that the wall bitplane and the field agree while a scene runs
+ *
+ * Walls are drawn, drains put under some of them and under water, and rain
+ * and the water brush run on top, in each kernel. Jacobi is also run
+ * temporally tiled, without the rain, which would make every frame step on
+ * its own. After every frame the wall bits must mark exactly the cells of
+ * `field` that hold WALL_VALUE. Built and run by `make check`; exits 1 on a
+ * difference.
+ */
+
+#include "game.h"
+#include "sim.h"
+#include "walls.h"
+
+#include <stdio.h>
+
+constexpr int FRAMES = 400;
+
+static void setupScene() {
+  n();
+  // Ledges, each with drains under part of its length and under open water
+  for (int i = 0; i < 4; i++) {
+    int y = 40 + i * 35;
+    logic_line(30 + i * 60, y, 100 + i * 60, y, 1);
+    for (int x = 40 + i * 60; x < 60 + i * 60; x++)
+      putCell(x, y + 1, DRAIN_VALUE);
+    for (int x = 110 + i * 40; x < 115 + i * 40; x++)
+      putCell(x, fieldHeight - 2, DRAIN_VALUE);
+  }
+  // A wall along row 1, where the rain lands
+  logic_line(200, 1, 280, 1, 1);
+  wakeAll();
+}
+
+static bool check(SimMode mode, int temporal, const char *name) {
+  init(300, 200);
+  seed_random(7);
+  set_sim_mode((int)mode);
+  set_temporal_steps(temporal);
+  setupScene();
+  game.rainmode = temporal == 1;
+  for (int frame = 0; frame < FRAMES; frame++) {
+    if (frame % 50 == 0) {
+      set_mouse_pos(30 + frame % 240, 20 + frame % 150);
+      set_mouse_button(2);
+    } else if (frame % 50 == 25) {
+      set_mouse_button(0);
+    }
+    update();
+    step_many(temporal);
+    if (!wallsMatchField()) {
+      printf("%s: wall bits and field differ after frame %d\n", name, frame);
+      return false;
+    }
+  }
+  return true;
+}
+
+int main() {
+  bool ok = check(SimMode::InPlace, 1, "in-place");
+  ok = check(SimMode::Jacobi, 1, "jacobi") && ok;
+  ok = check(SimMode::Jacobi, 4, "jacobi -k 4") && ok;
+  printf("walls: %s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+/**
+ * @file bench.cpp
+ * @brief Headless scenario benchmark for the simulation core
+ *
+ * Runs fixed scenes through update() and render() for a number of steps and
+ * reports per-cell cost, throughput and frame-time percentiles. Built by
+ * `make bench`; intended for catching regressions and for running the hot
+ * loops under perf or another profiler.
+ *
+ * Usage: slime_bench [-n steps] [-m inplace|jacobi] [-a] [-t threads]
+ *                    [-b steps] [-k steps] [-s WxH] [scenario ...]
+ *   -a  keep every tile awake (disable sleeping tiles)
+ *   -t  split the Jacobi kernel over this many threads
+ *   -b  steps per frame, run together through step_many() (default 1)
+ *   -k  temporal tiling depth for multi-step frames (see set_temporal_steps)
+ *   -s  field size (default 300x200); scenes are laid out for the default
+ */
+
+#include "game.h"
+#include "sim.h"
+
+#include <stdio.h>
+
+// =============================================================================
+// Scenarios
+// =============================================================================
+
+/// Fill every interior cell in rows [y1, y2] with the given density
+static void fillWater(int y1, int y2, int density) {
+  for (int x = 1; x < fieldWidth - 1; x++)
+    for (int y = y1; y <= y2; y++)
+      if (field[x][y] < WALL_VALUE)
+        field[x][y] = density;
+}
+
+/// Basin three quarters full of water, left to settle
+static void setupBasin() { fillWater(fieldHeight / 4, fieldHeight - 2, 40); }
+
+/// Tall column of water held behind a wall that is removed at step 0
+static void setupDamBreak() {
+  logic_line(100, 1, 100, fieldHeight - 2, 1);
+  for (int x = 1; x < 100; x++)
+    for (int y = 1; y < fieldHeight - 1; y++)
+      field[x][y] = 60;
+  clearLines();
+}
+
+/// Rain falling onto a staircase of ledges
+static void setupRain() {
+  for (int i = 0; i < 5; i++) {
+    int y = 40 + i * 30;
+    logic_line(20 + i * 50, y, 90 + i * 50, y + 10, 1);
+  }
+  game.rainmode = true;
+}
+
+/// A small cup leaking through a gap in its floor into an empty basin
+static void setupTrickle() {
+  logic_line(20, 20, 20, 60, 1);
+  logic_line(60, 20, 60, 60, 1);
+  logic_line(20, 60, 38, 60, 1);
+  logic_line(42, 60, 60, 60, 1);
+  for (int x = 21; x < 60; x++)
+    for (int y = 21; y < 60; y++)
+      field[x][y] = 30;
+}
+
+struct Scenario {
+  const char *name;
+  void (*setup)();
+};
+
+static const Scenario scenarios[] = {
+    {"basin", setupBasin},
+    {"dam", setupDamBreak},
+    {"rain", setupRain},
+    {"trickle", setupTrickle},
+};
+constexpr int NUM_SCENARIOS = sizeof(scenarios) / sizeof(scenarios[0]);
+
+// =============================================================================
+// Measurement
+// =============================================================================
+
+static int compareDouble(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+/// Value at percentile p (0-100) of an ascending sorted array
+static double percentile(const double *sorted, int n, double p) {
+  int i = (int)(p / 100.0 * (n - 1) + 0.5);
+  return sorted[i];
+}
+
+/// Total density over all water cells, reported as a behaviour checksum
+static long totalMass() {
+  long mass = 0;
+  for (int x = 0; x < fieldWidth; x++)
+    for (int y = 0; y < fieldHeight; y++)
+      if (field[x][y] < WALL_VALUE)
+        mass += field[x][y];
+  return mass;
+}
+
+static void run(const Scenario &sc, int steps, int batch, double *frameMs) {
+  seed_random(1);
+  n();
+  game.paused = false;
+  sc.setup();
+
+  double updateMs = 0, renderMs = 0;
+  long awakeTiles = 0;
+  int frames = 0;
+  for (int i = 0; i < steps; i += batch) {
+    int n = steps - i < batch ? steps - i : batch;
+    awakeTiles += (long)countAwakeTiles() * n;
+    double t0 = get_time_ms();
+    if (n == 1)
+      update();
+    else
+      step_many(n);
+    double t1 = get_time_ms();
+    render();
+    double t2 = get_time_ms();
+    updateMs += t1 - t0;
+    renderMs += t2 - t1;
+    frameMs[frames++] = t2 - t0;
+  }
+
+  qsort(frameMs, frames, sizeof(double), compareDouble);
+  double cellSteps = (double)steps * fieldWidth * fieldHeight;
+  printf("%-8s %7d %10.2f %10.2f %10.0f %8.1f %8.1f %8.1f %8.1f %9ld %7.1f\n",
+         sc.name, steps, updateMs * 1e6 / cellSteps,
+         renderMs * 1e6 / cellSteps, steps / (updateMs / 1000.0),
+         percentile(frameMs, frames, 50) * 1000.0,
+         percentile(frameMs, frames, 90) * 1000.0,
+         percentile(frameMs, frames, 99) * 1000.0, frameMs[frames - 1] * 1000.0,
+         totalMass(), 100.0 * awakeTiles / ((double)steps * tilesX * tilesY));
+}
+
+int main(int argc, char **argv) {
+  int steps = 2000, batch = 1;
+  int width = 0, height = 0;
+  const char *selected[NUM_SCENARIOS];
+  int numSelected = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+      steps = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+      i++;
+      set_sim_mode(!strcmp(argv[i], "jacobi") ? (int)SimMode::Jacobi
+                                               : (int)SimMode::InPlace);
+    } else if (!strcmp(argv[i], "-a")) {
+      set_sleep_tiles(0);
+    } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+      set_thread_count(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+      batch = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-k") && i + 1 < argc) {
+      set_temporal_steps(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+      sscanf(argv[++i], "%dx%d", &width, &height);
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr,
+              "usage: %s [-n steps] [-m inplace|jacobi] [-a] [-t threads] "
+              "[-b steps] [-k steps] [-s WxH] [scenario ...]\n",
+              argv[0]);
+      return 2;
+    } else if (numSelected < NUM_SCENARIOS) {
+      selected[numSelected++] = argv[i];
+    }
+  }
+  if (steps < 1)
+    steps = 1;
+  if (batch < 1)
+    batch = 1;
+
+  if (!init(width, height))
+    fprintf(stderr, "%dx%d does not fit in memory, using the default\n",
+            width, height);
+
+  double *frameMs = (double *)malloc(steps * sizeof(double));
+  printf("%-8s %7s %10s %10s %10s %8s %8s %8s %8s %9s %7s\n", "scenario",
+         "steps", "upd ns/c", "ren ns/c", "steps/s", "p50 us", "p90 us",
+         "p99 us", "max us", "mass", "awake%");
+  for (int s = 0; s < NUM_SCENARIOS; s++) {
+    bool wanted = numSelected == 0;
+    for (int i = 0; i < numSelected; i++)
+      wanted |= !strcmp(selected[i], scenarios[s].name);
+    if (wanted)
+      run(scenarios[s], steps, batch, frameMs);
+  }
+  free(frameMs);
+  return 0;
+}
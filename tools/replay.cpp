@@ -0,0 +1,160 @@
+/**
+ * @file replay.cpp
+ * @brief Headless replay of a recorded session, as a benchmark
+ *
+ * Plays back an input log recorded in the page (see replay.h) and reports
+ * how fast it ran. The session's input, seed and settings all come from the
+ * log, so every run of it does the same work, on any build and any
+ * machine; the recorded sessions make a benchmark corpus that follows how
+ * the game is really played. Built by `make replay`.
+ *
+ * Every checkpoint in the log is compared with the replayed world, and the
+ * exit status is 1 if one does not match. -t, -k and -a only change how the
+ * steps are computed, not their results, so this checks them as well.
+ *
+ * Usage: slime_replay [-f step] [-n step] [-e steps] [-r runs] [-t threads]
+ *                     [-k steps] [-a] log.slrec
+ *   -f  seek to this step counter first (not timed)
+ *   -n  stop at this step counter (default: the end of the log)
+ *   -e  steps per rendered frame (default 1, 0 = do not render)
+ *   -r  replay this many times and report the fastest run (default 1)
+ *   -t  split the Jacobi kernel over this many threads
+ *   -k  temporal tiling depth for multi-step frames (see set_temporal_steps)
+ *   -a  keep every tile awake (disable sleeping tiles)
+ */
+
+#include "game.h"
+#include "replay.h"
+#include "sim.h"
+
+#include <stdio.h>
+
+static long totalMass() {
+  long mass = 0;
+  for (int x = 0; x < fieldWidth; x++)
+    for (int y = 0; y < fieldHeight; y++)
+      if (field[x][y] < WALL_VALUE)
+        mass += field[x][y];
+  return mass;
+}
+
+/// Read the whole file; nullptr if it cannot be read
+static uint8_t *readFile(const char *path, int *size) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return nullptr;
+  fseek(f, 0, SEEK_END);
+  long n = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *data = n > 0 ? (uint8_t *)malloc(n) : nullptr;
+  if (data && fread(data, 1, n, f) != (size_t)n) {
+    free(data);
+    data = nullptr;
+  }
+  fclose(f);
+  *size = (int)n;
+  return data;
+}
+
+static int usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-f step] [-n step] [-e steps] [-r runs] [-t threads] "
+          "[-k steps] [-a] log.slrec\n",
+          argv0);
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  int from = 0, to = -1, every = 1, runs = 1;
+  int threads = 0, temporal = 0;
+  bool awake = false;
+  const char *path = nullptr;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(arg, "-f") && more) {
+      from = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-n") && more) {
+      to = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-e") && more) {
+      every = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-r") && more) {
+      runs = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-t") && more) {
+      threads = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-k") && more) {
+      temporal = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-a")) {
+      awake = true;
+    } else if (arg[0] == '-' || path) {
+      return usage(argv[0]);
+    } else {
+      path = arg;
+    }
+  }
+  if (!path)
+    return usage(argv[0]);
+  if (runs < 1)
+    runs = 1;
+
+  int size, width, height;
+  uint8_t *log = readFile(path, &size);
+  if (!log || !replayFieldSize(log, size, &width, &height)) {
+    fprintf(stderr, "%s is not a recorded session\n", path);
+    return 1;
+  }
+  if (!init(width, height)) {
+    fprintf(stderr, "%dx%d does not fit in memory\n", width, height);
+    return 1;
+  }
+  if (threads > 0)
+    set_thread_count(threads);
+  if (temporal > 0)
+    set_temporal_steps(temporal);
+
+  double best = 0, updateMs = 0, renderMs = 0;
+  int start = 0, end = 0;
+  bool matched = true;
+  for (int run = 0; run < runs; run++) {
+    if (!openReplay(log, size)) {
+      fprintf(stderr, "%s is malformed or truncated\n", path);
+      return 1;
+    }
+    // After the log's own setting, which comes at its first step
+    start = seek_replay(from);
+    if (awake)
+      set_sleep_tiles(0);
+    int stop = to >= 0 ? to : get_replay_length();
+
+    double u = 0, r = 0;
+    while (game.frames < stop && !replay_done()) {
+      int target = every > 0 ? game.frames + every : stop;
+      double t0 = get_time_ms();
+      replay_to(target < stop ? target : stop);
+      double t1 = get_time_ms();
+      if (every > 0)
+        render();
+      u += t1 - t0;
+      r += get_time_ms() - t1;
+    }
+    end = game.frames;
+    matched &= get_replay_mismatches() == 0;
+    if (run == 0 || u + r < best) {
+      best = u + r;
+      updateMs = u;
+      renderMs = r;
+    }
+  }
+
+  int steps = end - start;
+  printf("%s: %dx%d, steps %d to %d of %d\n", path, width, height, start, end,
+         get_replay_length());
+  printf("update %.1f ms (%.0f steps/s, %.3f ms/step), render %.1f ms\n",
+         updateMs, steps > 0 ? steps / (updateMs / 1000.0) : 0.0,
+         steps > 0 ? updateMs / steps : 0.0, renderMs);
+  printf("mass %ld, checkpoints %d, mismatched %d\n", totalMass(),
+         get_replay_checkpoints(), get_replay_mismatches());
+  free(log);
+  return matched ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file scene.cpp
+ * @brief Scene file parser shared by the headless tools
+ */
+
+#include "scene.h"
+#include "walls.h"
+
+#include <stdio.h>
+
+static bool readFile(const char *path, char **text) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  *text = (char *)malloc(size + 1);
+  long got = fread(*text, 1, size, f);
+  (*text)[got] = 0;
+  fclose(f);
+  return true;
+}
+
+static bool parseSwitch(const char *word, bool *out) {
+  if (!strcmp(word, "on"))
+    *out = true;
+  else if (!strcmp(word, "off"))
+    *out = false;
+  else
+    return false;
+  return true;
+}
+
+/// Apply the settings in the scene (pass 0) or its edits (pass 1). Returns
+/// false and reports the line on a syntax error.
+static bool applyScene(Scene &scene, int pass) {
+  char *text = scene.text;
+  int lineNo = 0;
+  while (text && *text) {
+    char *line = text;
+    char *end = strchr(text, '\n');
+    text = end ? end + 1 : nullptr;
+    char buf[256];
+    int len = end ? (int)(end - line) : (int)strlen(line);
+    if (len > (int)sizeof(buf) - 1)
+      len = sizeof(buf) - 1;
+    memcpy(buf, line, len);
+    buf[len] = 0;
+    lineNo++;
+    if (char *hash = strchr(buf, '#'))
+      *hash = 0;
+
+    char cmd[16], word[16];
+    int a[5];
+    if (sscanf(buf, "%15s", cmd) != 1)
+      continue;
+    bool ok;
+    if (!strcmp(cmd, "size")) {
+      ok = sscanf(buf, "%*s %d %d", &a[0], &a[1]) == 2;
+      if (ok && pass == 0) {
+        scene.width = a[0];
+        scene.height = a[1];
+      }
+    } else if (!strcmp(cmd, "seed")) {
+      unsigned seed;
+      ok = sscanf(buf, "%*s %u", &seed) == 1;
+      if (ok && pass == 0)
+        scene.seed = seed;
+    } else if (!strcmp(cmd, "mode")) {
+      ok = sscanf(buf, "%*s %15s", word) == 1 &&
+           (!strcmp(word, "inplace") || !strcmp(word, "jacobi"));
+      if (ok && pass == 0)
+        scene.mode = !strcmp(word, "jacobi") ? SimMode::Jacobi
+                                             : SimMode::InPlace;
+    } else if (!strcmp(cmd, "sleep")) {
+      bool on;
+      ok = sscanf(buf, "%*s %15s", word) == 1 && parseSwitch(word, &on);
+      if (ok && pass == 0)
+        scene.sleep = on;
+    } else if (!strcmp(cmd, "rain")) {
+      bool on;
+      ok = sscanf(buf, "%*s %15s", word) == 1 && parseSwitch(word, &on);
+      if (ok && pass == 0)
+        scene.rain = on;
+    } else if (!strcmp(cmd, "wall")) {
+      ok = sscanf(buf, "%*s %d %d %d %d", &a[0], &a[1], &a[2], &a[3]) == 4;
+      if (ok && pass == 1)
+        logic_line(a[0], a[1], a[2], a[3], 1);
+    } else if (!strcmp(cmd, "water") || !strcmp(cmd, "clear")) {
+      bool water = cmd[0] == 'w';
+      a[4] = 0;
+      ok = sscanf(buf, "%*s %d %d %d %d %d", &a[0], &a[1], &a[2], &a[3],
+                  &a[4]) == (water ? 5 : 4);
+      if (ok && pass == 1) {
+        int max = simParams.maxWater;
+        int density = a[4] < 0 ? 0 : (a[4] > max ? max : a[4]);
+        int x1 = a[0] < a[2] ? a[0] : a[2], x2 = a[0] < a[2] ? a[2] : a[0];
+        int y1 = a[1] < a[3] ? a[1] : a[3], y2 = a[1] < a[3] ? a[3] : a[1];
+        for (int x = x1 < 1 ? 1 : x1; x <= x2 && x < fieldWidth - 1; x++)
+          for (int y = y1 < 1 ? 1 : y1; y <= y2 && y < fieldHeight - 1; y++) {
+            if (!water && isWall(x, y))
+              removeWall(x, y);
+            if (field[x][y] < WALL_VALUE)
+              field[x][y] = density;
+          }
+        wakeRect(x1, y1, x2, y2);
+      }
+    } else {
+      ok = false;
+    }
+    if (!ok) {
+      fprintf(stderr, "%s:%d: cannot parse '%s'\n", scene.path, lineNo,
+              buf);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool loadScene(Scene *scene, const char *path) {
+  scene->path = path;
+  if (!readFile(path, &scene->text)) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return false;
+  }
+  return applyScene(*scene, 0);
+}
+
+bool applySceneEdits(Scene &scene) {
+  return !scene.text || applyScene(scene, 1);
+}
@@ -0,0 +1,41 @@
+/**
+ * @file scene.h
+ * @brief Plain-text scene files for the headless tools
+ *
+ * Scene files are plain text, one command per line, `#` starts a comment:
+ *   size W H                 field size (before anything else applies)
+ *   seed N                   random seed
+ *   mode inplace|jacobi      flow kernel
+ *   sleep on|off             sleeping tiles
+ *   rain on|off              rain
+ *   wall X1 Y1 X2 Y2         wall line
+ *   water X1 Y1 X2 Y2 D      fill the rectangle's free cells with density D
+ *   clear X1 Y1 X2 Y2        remove walls and water in the rectangle
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "game.h"
+#include "sim.h"
+
+/// Settings read from a scene file; the edits are kept as text
+struct Scene {
+  int width = 0, height = 0;
+  uint32_t seed = 0;
+  SimMode mode = SimMode::InPlace;
+  bool sleep = true;
+  bool rain = false;
+  const char *path = nullptr;
+  char *text = nullptr; ///< Whole file, edit commands applied after init()
+};
+
+/// Read a scene file and its settings. Reports the problem on stderr and
+/// returns false if the file cannot be read or parsed.
+bool loadScene(Scene *scene, const char *path);
+
+/// Apply the scene's walls and water to the field after init() (nothing for
+/// a scene that was never loaded)
+bool applySceneEdits(Scene &scene);
+
+#endif
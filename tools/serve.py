@@ -0,0 +1,22 @@
+"""Serve docs/ with the headers needed for the threaded build.
+
+SharedArrayBuffer (and so slime-threads.wasm) is only available to pages
+that are cross-origin isolated, which requires the COOP and COEP headers.
+"""
+
+import http.server
+import sys
+
+
+class Handler(http.server.SimpleHTTPRequestHandler):
+    def end_headers(self):
+        self.send_header("Cross-Origin-Opener-Policy", "same-origin")
+        self.send_header("Cross-Origin-Embedder-Policy", "require-corp")
+        super().end_headers()
+
+
+if __name__ == "__main__":
+    directory = sys.argv[1] if len(sys.argv) > 1 else "docs"
+    port = int(sys.argv[2]) if len(sys.argv) > 2 else 8000
+    handler = lambda *a, **kw: Handler(*a, directory=directory, **kw)
+    http.server.ThreadingHTTPServer(("", port), handler).serve_forever()
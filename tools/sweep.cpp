@@ -0,0 +1,376 @@
+/**
+ * @file sweep.cpp
+ * @brief Parameter sweep: one world per combination, spread over all cores
+ *
+ * Runs every combination of the given parameter values (see Param in sim.h)
+ * on the same scene and reports, per combination, how long the water takes
+ * to level out, how much mass it loses and how level it ends up. Built by
+ * `make sweep`.
+ *
+ * The engine keeps its world in globals, so worlds cannot share a process
+ * and run at the same time (the SimContext of slime.h only switches one
+ * world at a time in and out of them). The pool is made of forked worker
+ * processes instead: each claims the next unstarted combination from a
+ * counter in shared memory until none are left, so a worker that drew cheap
+ * combinations simply takes more of them. Workers share nothing else, which
+ * keeps the speedup close to the number of cores.
+ *
+ * Usage: slime_sweep [-n steps] [-j workers] [-o report.csv] [-q level]
+ *                    [-s WxH] [-S seed] [-m inplace|jacobi]
+ *                    [-p name=values ...] [scene]
+ *   -n  step limit per combination (default 10000)
+ *   -j  worker processes (default: one per online CPU)
+ *   -q  flatness at which the water counts as settled (default 0.25)
+ *   -p  values of one parameter as a list (1,2,4) or a range (lo:hi[:step]);
+ *       names are density_flow, max_water, rain_probability,
+ *       water_spawn_amount and sweep_order (0 reference, 1 alternating,
+ *       2 serpentine). Parameters not given keep their defaults, and
+ *       without any -p density_flow and max_water are swept.
+ *
+ * Flatness is the coefficient of variation of the water mass per column: 0
+ * for water lying level across the basin, growing as it piles up on one
+ * side. Individual cells keep flickering long after the water has spread
+ * out, so settling is judged on this slow quantity rather than on cells
+ * that changed. A combination stops at the first check (every
+ * SETTLE_INTERVAL steps) that finds it settled.
+ *
+ * The report is CSV, one row per combination in sweep order: the parameter
+ * values, settle_step (-1 if the step limit came first), steps run, start
+ * and end mass, mass_loss_pct, the final flatness and the average step time
+ * in ms. Without a scene the field starts with its left third full of water
+ * (a dam break).
+ */
+
+#include "game.h"
+#include "scene.h"
+#include "sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+constexpr int NUM_PARAMS = (int)Param::Count;
+constexpr int MAX_VALUES = 64;      ///< Values per parameter
+constexpr int SETTLE_INTERVAL = 10; ///< Steps between flatness checks
+
+static const char *paramNames[NUM_PARAMS] = {
+    "density_flow", "max_water", "rain_probability", "water_spawn_amount",
+    "sweep_order"};
+
+// =============================================================================
+// Sweep Grid
+// =============================================================================
+
+struct Axis {
+  int values[MAX_VALUES];
+  int count = 0;
+};
+
+static Axis axes[NUM_PARAMS];
+
+/// Parse "name=v1,v2,..." or "name=lo:hi[:step]" into its axis
+static bool parseAxis(const char *spec) {
+  const char *eq = strchr(spec, '=');
+  if (!eq)
+    return false;
+  int param = -1;
+  for (int i = 0; i < NUM_PARAMS; i++)
+    if ((int)strlen(paramNames[i]) == eq - spec &&
+        !strncmp(spec, paramNames[i], eq - spec))
+      param = i;
+  if (param < 0)
+    return false;
+
+  Axis &axis = axes[param];
+  axis.count = 0;
+  int lo, hi, step = 1;
+  int fields = sscanf(eq + 1, "%d:%d:%d", &lo, &hi, &step);
+  if (fields >= 2 && strchr(eq + 1, ':')) {
+    if (step < 1 || hi < lo)
+      return false;
+    for (int v = lo; v <= hi && axis.count < MAX_VALUES; v += step)
+      axis.values[axis.count++] = v;
+    return true;
+  }
+  for (const char *p = eq + 1; *p && axis.count < MAX_VALUES;) {
+    char *end;
+    axis.values[axis.count++] = (int)strtol(p, &end, 10);
+    if (end == p || (*end && *end != ','))
+      return false;
+    p = *end ? end + 1 : end;
+  }
+  return axis.count > 0;
+}
+
+/// Number of combinations in the grid
+static int comboCount() {
+  int n = 1;
+  for (const Axis &axis : axes)
+    n *= axis.count;
+  return n;
+}
+
+/// Parameter values of combination i; the last parameter varies fastest
+static void comboValues(int i, int *values) {
+  for (int p = NUM_PARAMS - 1; p >= 0; p--) {
+    values[p] = axes[p].values[i % axes[p].count];
+    i /= axes[p].count;
+  }
+}
+
+// =============================================================================
+// Measurement
+// =============================================================================
+
+struct Result {
+  int settleStep;
+  int steps;
+  long massStart, massEnd;
+  double flatness;
+  double stepMs;
+  bool done;
+};
+
+static long totalMass() {
+  long mass = 0;
+  for (int x = 0; x < fieldWidth; x++)
+    for (int y = 0; y < fieldHeight; y++)
+      if (field[x][y] < WALL_VALUE)
+        mass += field[x][y];
+  return mass;
+}
+
+/// Coefficient of variation of the water mass in the interior columns
+static double flatness() {
+  double sum = 0, sumSq = 0;
+  int columns = fieldWidth - 2;
+  for (int x = 1; x < fieldWidth - 1; x++) {
+    const uint8_t *column = field[x];
+    long mass = 0;
+    for (int y = 1; y < fieldHeight - 1; y++)
+      mass += column[y] < WALL_VALUE ? column[y] : 0;
+    sum += mass;
+    sumSq += (double)mass * mass;
+  }
+  double mean = sum / columns;
+  double variance = sumSq / columns - mean * mean;
+  return mean > 0 && variance > 0 ? sqrt(variance) / mean : 0;
+}
+
+/// Default scene: the left third of the basin full of water
+static void setupDamBreak() {
+  for (int x = 1; x < fieldWidth / 3; x++)
+    for (int y = 1; y < fieldHeight - 1; y++)
+      field[x][y] = 60;
+  wakeAll();
+}
+
+static void runCombo(Scene &scene, const int *values, int steps, double level,
+                     Result *result) {
+  // Everything a step depends on starts over, down to the sweep parity
+  // (reset by n()), so a combination gives the same result in any worker
+  seed_random(scene.seed);
+  n();
+  game.paused = false;
+  for (int p = 0; p < NUM_PARAMS; p++)
+    set_param(p, values[p]);
+  if (scene.text)
+    applySceneEdits(scene);
+  else
+    setupDamBreak();
+  game.rainmode = scene.rain;
+
+  result->massStart = totalMass();
+  result->settleStep = -1;
+
+  int step = 0;
+  double stepMs = 0;
+  while (step < steps) {
+    double t0 = get_time_ms();
+    update();
+    stepMs += get_time_ms() - t0;
+    step++;
+    if (step % SETTLE_INTERVAL == 0 && flatness() <= level) {
+      result->settleStep = step;
+      break;
+    }
+  }
+
+  result->steps = step;
+  result->massEnd = totalMass();
+  result->flatness = flatness();
+  result->stepMs = step > 0 ? stepMs / step : 0;
+  result->done = true;
+}
+
+// =============================================================================
+// Main
+// =============================================================================
+
+static int usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-n steps] [-j workers] [-o report.csv] [-q level] "
+          "[-s WxH] [-S seed] [-m inplace|jacobi] [-p name=values ...] "
+          "[scene]\n",
+          argv0);
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  int steps = 10000;
+  int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  double level = 0.25;
+  const char *reportPath = nullptr;
+  const char *scenePath = nullptr;
+  int width = -1, height = -1, mode = -1;
+  long long seed = -1;
+  bool swept = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool more = i + 1 < argc;
+    if (!strcmp(arg, "-n") && more) {
+      steps = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-j") && more) {
+      workers = atoi(argv[++i]);
+    } else if (!strcmp(arg, "-o") && more) {
+      reportPath = argv[++i];
+    } else if (!strcmp(arg, "-q") && more) {
+      level = atof(argv[++i]);
+    } else if (!strcmp(arg, "-s") && more) {
+      if (sscanf(argv[++i], "%dx%d", &width, &height) != 2)
+        return usage(argv[0]);
+    } else if (!strcmp(arg, "-S") && more) {
+      seed = strtoll(argv[++i], nullptr, 10);
+    } else if (!strcmp(arg, "-m") && more) {
+      i++;
+      if (!strcmp(argv[i], "jacobi")) {
+        mode = (int)SimMode::Jacobi;
+      } else if (!strcmp(argv[i], "inplace")) {
+        mode = (int)SimMode::InPlace;
+      } else {
+        fprintf(stderr, "unknown mode '%s'\n", argv[i]);
+        return usage(argv[0]);
+      }
+    } else if (!strcmp(arg, "-p") && more) {
+      if (!parseAxis(argv[++i])) {
+        fprintf(stderr, "bad parameter values '%s'\n", argv[i]);
+        return usage(argv[0]);
+      }
+      swept = true;
+    } else if (arg[0] == '-' || scenePath) {
+      return usage(argv[0]);
+    } else {
+      scenePath = arg;
+    }
+  }
+  if (!swept) {
+    parseAxis("density_flow=1:4");
+    parseAxis("max_water=49:97:16");
+  }
+
+  Scene scene;
+  if (scenePath && !loadScene(&scene, scenePath))
+    return 1;
+  if (width >= 0) {
+    scene.width = width;
+    scene.height = height;
+  }
+  if (seed >= 0)
+    scene.seed = (uint32_t)seed;
+  if (mode >= 0)
+    scene.mode = (SimMode)mode;
+
+  // Every axis left out holds the current default
+  if (!init(scene.width, scene.height)) {
+    fprintf(stderr, "%dx%d does not fit in memory\n", scene.width,
+            scene.height);
+    return 1;
+  }
+  for (int p = 0; p < NUM_PARAMS; p++)
+    if (axes[p].count == 0)
+      axes[p].values[axes[p].count++] = get_param(p);
+  set_sim_mode((int)scene.mode);
+  set_sleep_tiles(scene.sleep);
+
+  int combos = comboCount();
+  if (workers < 1)
+    workers = 1;
+  if (workers > combos)
+    workers = combos;
+
+  // The claim counter and the results live in memory the workers share
+  size_t shared = sizeof(int) + combos * sizeof(Result);
+  void *mem = mmap(nullptr, shared, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  memset(mem, 0, shared);
+  int *next = (int *)mem;
+  Result *results = (Result *)(next + 1);
+
+  double t0 = get_time_ms();
+  for (int w = 0; w < workers; w++) {
+    pid_t pid = fork();
+    if (pid < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (pid == 0) {
+      int values[NUM_PARAMS];
+      for (;;) {
+        int i = __atomic_fetch_add(next, 1, __ATOMIC_RELAXED);
+        if (i >= combos)
+          break;
+        comboValues(i, values);
+        runCombo(scene, values, steps, level, &results[i]);
+      }
+      _exit(0);
+    }
+  }
+  bool failed = false;
+  int status;
+  while (wait(&status) > 0)
+    failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+  double wallMs = get_time_ms() - t0;
+
+  FILE *report = reportPath ? fopen(reportPath, "w") : stdout;
+  if (!report) {
+    fprintf(stderr, "cannot write %s\n", reportPath);
+    return 1;
+  }
+  for (int p = 0; p < NUM_PARAMS; p++)
+    fprintf(report, "%s,", paramNames[p]);
+  fprintf(report, "settle_step,steps,mass_start,mass_end,mass_loss_pct,"
+                  "flatness,step_ms\n");
+  for (int i = 0; i < combos; i++) {
+    const Result &r = results[i];
+    if (!r.done) {
+      failed = true;
+      continue;
+    }
+    int values[NUM_PARAMS];
+    comboValues(i, values);
+    for (int p = 0; p < NUM_PARAMS; p++)
+      fprintf(report, "%d,", values[p]);
+    double loss = r.massStart > 0
+                      ? 100.0 * (r.massStart - r.massEnd) / r.massStart
+                      : 0.0;
+    fprintf(report, "%d,%d,%ld,%ld,%.3f,%.3f,%.4f\n", r.settleStep, r.steps,
+            r.massStart, r.massEnd, loss, r.flatness, r.stepMs);
+  }
+  if (report != stdout && fclose(report) != 0) {
+    fprintf(stderr, "cannot write %s\n", reportPath);
+    return 1;
+  }
+
+  fprintf(stderr, "%d combinations on %d workers in %.1f s\n", combos,
+          workers, wallMs / 1000.0);
+  if (failed)
+    fprintf(stderr, "some combinations did not finish\n");
+  return failed ? 1 : 0;
+}